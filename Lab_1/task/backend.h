@@ -0,0 +1,141 @@
+#ifndef TASK_BACKEND_H
+#define TASK_BACKEND_H
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_PARALLEL_STL
+#include <execution>
+#endif
+
+#include "pool.h"
+
+// Parallel runtimes the row sums can be run on. Each one is handed the same
+// per-range body, so only the way rows reach the threads differs.
+enum class Backend {
+    Pool,
+    Threads,
+    OmpStatic,
+    OmpDynamic,
+    ParallelStl,
+};
+
+const Backend AllBackends[] = {Backend::Pool, Backend::Threads, Backend::OmpStatic, Backend::OmpDynamic, Backend::ParallelStl};
+
+inline const char *backendName(Backend backend) {
+    switch (backend) {
+        case Backend::Pool:
+            return "pool";
+        case Backend::Threads:
+            return "threads";
+        case Backend::OmpStatic:
+            return "omp-static";
+        case Backend::OmpDynamic:
+            return "omp-dynamic";
+        case Backend::ParallelStl:
+            return "par-stl";
+    }
+    return "unknown";
+}
+
+inline bool parseBackend(const std::string &name, Backend &backend) {
+    for (Backend candidate : AllBackends) {
+        if (name == backendName(candidate)) {
+            backend = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// OpenMP and the parallel algorithms are only there when the build found
+// them; see CMakeLists.txt.
+inline bool isBackendAvailable(Backend backend) {
+    switch (backend) {
+        case Backend::OmpStatic:
+        case Backend::OmpDynamic:
+#ifdef _OPENMP
+            return true;
+#else
+            return false;
+#endif
+        case Backend::ParallelStl:
+#ifdef HAVE_PARALLEL_STL
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return true;
+    }
+}
+
+// Calls body(startRow, endRow) over all rows on `backend` with `threads`
+// threads:
+//   pool         the persistent pinned workers, one contiguous block each;
+//   threads      a fresh std::thread per block, created and joined per call;
+//   omp-static   parallel for, schedule(static), one block per thread;
+//   omp-dynamic  parallel for over blocks of `grain` rows, schedule(dynamic);
+//   par-stl      std::for_each(std::execution::par) over `threads` blocks.
+// The parallel algorithms pick their own thread count, so for par-stl
+// `threads` only sets how many blocks there are.
+template <typename Body>
+void runOnBackend(Backend backend, int rows, int threads, int grain, WorkerPool &pool, const Body &body) {
+    switch (backend) {
+        case Backend::Pool:
+            pool.run(threads, [&](int t) {
+                RowRange range = partitionRows(rows, threads, t);
+                body(range.startRow, range.endRow);
+            });
+            break;
+        case Backend::Threads: {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    RowRange range = partitionRows(rows, threads, t);
+                    body(range.startRow, range.endRow);
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            break;
+        }
+#ifdef _OPENMP
+        case Backend::OmpStatic:
+#pragma omp parallel for schedule(static) num_threads(threads)
+            for (int t = 0; t < threads; ++t) {
+                RowRange range = partitionRows(rows, threads, t);
+                body(range.startRow, range.endRow);
+            }
+            break;
+        case Backend::OmpDynamic: {
+            int step = std::max(1, grain);
+            int blocks = (rows + step - 1) / step;
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+            for (int block = 0; block < blocks; ++block) {
+                body(block * step, std::min(rows, (block + 1) * step));
+            }
+            break;
+        }
+#endif
+#ifdef HAVE_PARALLEL_STL
+        case Backend::ParallelStl: {
+            std::vector<RowRange> blocks(threads);
+            for (int t = 0; t < threads; ++t) {
+                blocks[t] = partitionRows(rows, threads, t);
+            }
+            std::for_each(std::execution::par, blocks.begin(), blocks.end(),
+                          [&](RowRange range) { body(range.startRow, range.endRow); });
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+}
+
+#endif //TASK_BACKEND_H
@@ -0,0 +1,347 @@
+#ifndef TASK_BENCH_H
+#define TASK_BENCH_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchStats {
+    int samples = 0;
+    double min = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double mean = 0.0;
+    double stddev = 0.0;
+};
+
+inline double percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    double position = fraction * (sorted.size() - 1);
+    size_t lower = static_cast<size_t>(position);
+    size_t upper = std::min(lower + 1, sorted.size() - 1);
+    return sorted[lower] + (sorted[upper] - sorted[lower]) * (position - lower);
+}
+
+inline BenchStats computeStats(std::vector<double> samples) {
+    BenchStats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    stats.samples = static_cast<int>(samples.size());
+    stats.min = samples.front();
+    stats.median = percentile(samples, 0.5);
+    stats.p95 = percentile(samples, 0.95);
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    stats.mean = sum / samples.size();
+    double squares = 0.0;
+    for (double sample : samples) {
+        squares += (sample - stats.mean) * (sample - stats.mean);
+    }
+    stats.stddev = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0.0;
+    return stats;
+}
+
+// Runs `body` warmup times untimed, then `repetitions` times, collecting the
+// seconds each call reports.
+template <typename Body>
+std::vector<double> measure(int warmup, int repetitions, Body body) {
+    for (int i = 0; i < warmup; ++i) {
+        body();
+    }
+    std::vector<double> samples;
+    samples.reserve(repetitions);
+    for (int i = 0; i < repetitions; ++i) {
+        samples.push_back(body());
+    }
+    return samples;
+}
+
+// Where the wall time of one parallel run went: from dispatch until the
+// first worker started, the mean time a worker spent on its rows, from the
+// last worker finishing until the join returned, and checking the result.
+struct PhaseTimes {
+    double dispatch = 0.0;
+    double compute = 0.0;
+    double tail = 0.0;
+    double verify = 0.0;
+
+    PhaseTimes &operator+=(const PhaseTimes &other) {
+        dispatch += other.dispatch;
+        compute += other.compute;
+        tail += other.tail;
+        verify += other.verify;
+        return *this;
+    }
+
+    PhaseTimes operator/(double count) const { return {dispatch / count, compute / count, tail / count, verify / count}; }
+};
+
+// Records when each worker of one parallel run started and finished,
+// relative to the moment the work was dispatched.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(int workers) : m_starts(workers, 0.0), m_ends(workers, 0.0) {}
+
+    void dispatch() { m_dispatch = Clock::now(); }
+
+    void workerStarted(int worker) { m_starts[worker] = elapsed(); }
+
+    void workerFinished(int worker) { m_ends[worker] = elapsed(); }
+
+    // Call once the join returns; gives the wall time of the whole run.
+    double joined() { return m_joined = elapsed(); }
+
+    std::vector<double> busySeconds() const {
+        std::vector<double> seconds(m_starts.size());
+        for (size_t t = 0; t < seconds.size(); ++t) {
+            seconds[t] = m_ends[t] - m_starts[t];
+        }
+        return seconds;
+    }
+
+    PhaseTimes phases() const {
+        PhaseTimes phases;
+        if (m_starts.empty()) {
+            return phases;
+        }
+        std::vector<double> busy = busySeconds();
+        for (double seconds : busy) {
+            phases.compute += seconds;
+        }
+        phases.compute /= busy.size();
+        phases.dispatch = *std::min_element(m_starts.begin(), m_starts.end());
+        phases.tail = std::max(0.0, m_joined - *std::max_element(m_ends.begin(), m_ends.end()));
+        return phases;
+    }
+
+private:
+    using Clock = std::chrono::high_resolution_clock;
+
+    double elapsed() const { return std::chrono::duration<double>(Clock::now() - m_dispatch).count(); }
+
+    Clock::time_point m_dispatch = Clock::now();
+    std::vector<double> m_starts;
+    std::vector<double> m_ends;
+    double m_joined = 0.0;
+};
+
+struct BenchRecord {
+    int matrixSize = 0;
+    std::string config;
+    int grain = 0;
+    std::string kernel;
+    std::string accumulator;
+    double bytes = 0.0;
+    bool correct = true;
+    BenchStats stats;
+    double imbalance = 0.0;
+    std::string pages = "4k";
+    PhaseTimes phases;
+    double peakPercent = 0.0;
+    std::string roofline = "-";
+    double flops = 0.0;
+
+    BenchRecord() = default;
+
+    // Takes every field a run produces, so a field added here has to be
+    // filled in at each call site; peakPercent, roofline and flops are set
+    // afterwards by the callers that have them.
+    BenchRecord(int matrixSize, std::string config, int grain, std::string kernel, std::string accumulator, double bytes, bool correct,
+                BenchStats stats, double imbalance, std::string pages, PhaseTimes phases)
+        : matrixSize(matrixSize), config(std::move(config)), grain(grain), kernel(std::move(kernel)),
+          accumulator(std::move(accumulator)), bytes(bytes), correct(correct), stats(stats), imbalance(imbalance),
+          pages(std::move(pages)), phases(phases) {}
+
+    double gbPerSecond() const { return stats.median > 0 ? bytes / stats.median * 1e-9 : 0.0; }
+
+    double gflopsPerSecond() const { return stats.median > 0 ? flops / stats.median * 1e-9 : 0.0; }
+
+    std::string key() const {
+        return std::to_string(matrixSize) + "/" + config + "/" + std::to_string(grain) + "/" + kernel + "/" + accumulator;
+    }
+};
+
+class BenchReport {
+public:
+    void add(const BenchRecord &record) { m_records.push_back(record); }
+
+    const std::vector<BenchRecord> &records() const { return m_records; }
+
+    void writeCsv(std::ostream &out) const {
+        out << "matrix_size,config,grain,kernel,accumulator,samples,min_s,median_s,p95_s,mean_s,stddev_s,gb_per_s,correct,imbalance_pct,pages,"
+               "dispatch_s,compute_s,tail_s,verify_s,peak_pct,roofline,gflop_per_s" << std::endl;
+        for (const BenchRecord &r : m_records) {
+            out << r.matrixSize << ',' << r.config << ',' << r.grain << ',' << r.kernel << ',' << r.accumulator << ','
+                << r.stats.samples << ',' << std::setprecision(9) << r.stats.min << ',' << r.stats.median << ','
+                << r.stats.p95 << ',' << r.stats.mean << ',' << r.stats.stddev << ',' << r.gbPerSecond() << ','
+                << (r.correct ? "yes" : "no") << ',' << r.imbalance << ',' << r.pages << ','
+                << r.phases.dispatch << ',' << r.phases.compute << ',' << r.phases.tail << ',' << r.phases.verify << ','
+                << r.peakPercent << ',' << r.roofline << ',' << r.gflopsPerSecond() << std::endl;
+        }
+    }
+
+    // One object per line so the baseline reader can stay line-based.
+    void writeJson(std::ostream &out) const {
+        out << "[" << std::endl;
+        for (size_t i = 0; i < m_records.size(); ++i) {
+            const BenchRecord &r = m_records[i];
+            out << "  {\"matrix_size\": " << r.matrixSize << ", \"config\": \"" << r.config << "\", \"grain\": " << r.grain
+                << ", \"kernel\": \"" << r.kernel << "\", \"accumulator\": \"" << r.accumulator << "\", \"samples\": "
+                << r.stats.samples << std::setprecision(9) << ", \"min_s\": " << r.stats.min << ", \"median_s\": "
+                << r.stats.median << ", \"p95_s\": " << r.stats.p95 << ", \"mean_s\": " << r.stats.mean
+                << ", \"stddev_s\": " << r.stats.stddev << ", \"gb_per_s\": " << r.gbPerSecond()
+                << ", \"correct\": " << (r.correct ? "true" : "false") << ", \"imbalance_pct\": " << r.imbalance
+                << ", \"pages\": \"" << r.pages << "\", \"dispatch_s\": " << r.phases.dispatch << ", \"compute_s\": "
+                << r.phases.compute << ", \"tail_s\": " << r.phases.tail << ", \"verify_s\": " << r.phases.verify
+                << ", \"peak_pct\": " << r.peakPercent << ", \"roofline\": \"" << r.roofline << "\", \"gflop_per_s\": "
+                << r.gflopsPerSecond() << "}" << (i + 1 < m_records.size() ? "," : "")
+                << std::endl;
+        }
+        out << "]" << std::endl;
+    }
+
+    bool write(const std::string &format, const std::string &path) const {
+        std::ofstream file;
+        if (!path.empty()) {
+            file.open(path);
+            if (!file) {
+                return false;
+            }
+        }
+        std::ostream &out = path.empty() ? std::cout : file;
+        if (format == "json") {
+            writeJson(out);
+        } else {
+            writeCsv(out);
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Prints every record whose median is more than `thresholdPercent` slower
+    // than the baseline median for the same key. Returns the number flagged.
+    int compare(const std::map<std::string, double> &baseline, double thresholdPercent) const {
+        int regressions = 0;
+        int matched = 0;
+        std::cout << "\nBaseline comparison (threshold " << thresholdPercent << "%):" << std::endl;
+        for (const BenchRecord &r : m_records) {
+            auto it = baseline.find(r.key());
+            if (it == baseline.end() || it->second <= 0) {
+                continue;
+            }
+            ++matched;
+            double change = (r.stats.median / it->second - 1.0) * 100.0;
+            if (change > thresholdPercent) {
+                ++regressions;
+                std::cout << "REGRESSION " << r.matrixSize << "\t" << r.config << "\t" << std::fixed << std::setprecision(6)
+                          << it->second << " -> " << r.stats.median << "\t(+" << std::setprecision(1) << change << "%)" << std::endl;
+            }
+        }
+        std::cout << matched << " configs matched the baseline, " << regressions << " regression(s)" << std::endl;
+        return regressions;
+    }
+
+private:
+    std::vector<BenchRecord> m_records;
+};
+
+// Whole-field numeric parsing for report files: false on empty input, trailing
+// characters or overflow instead of throwing.
+inline bool parseReportField(const std::string &text, int &value) {
+    char *end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+inline bool parseReportField(const std::string &text, double &value) {
+    char *end = nullptr;
+    errno = 0;
+    double parsed = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || errno == ERANGE) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// Reads median times keyed like BenchRecord::key() from a report previously
+// written by BenchReport in either CSV or JSON form. Lines that are not
+// records, or whose numbers do not parse, are skipped; returns false when the
+// file cannot be read or holds no usable record.
+inline bool loadBaseline(const std::string &path, std::map<std::string, double> &baseline) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    auto jsonField = [](const std::string &line, const std::string &name) {
+        size_t pos = line.find("\"" + name + "\":");
+        if (pos == std::string::npos) {
+            return std::string();
+        }
+        pos = line.find_first_not_of(" \"", pos + name.size() + 3);
+        size_t end = line.find_first_of(",\"}", pos);
+        return line.substr(pos, end - pos);
+    };
+    std::string line;
+    while (std::getline(file, line)) {
+        BenchRecord record;
+        std::string median;
+        if (line.find('{') != std::string::npos) {
+            record.config = jsonField(line, "config");
+            record.kernel = jsonField(line, "kernel");
+            record.accumulator = jsonField(line, "accumulator");
+            median = jsonField(line, "median_s");
+            std::string size = jsonField(line, "matrix_size");
+            std::string grain = jsonField(line, "grain");
+            if (!parseReportField(size, record.matrixSize) || !parseReportField(grain, record.grain)) {
+                continue;
+            }
+        } else {
+            std::vector<std::string> fields;
+            std::stringstream stream(line);
+            std::string field;
+            while (std::getline(stream, field, ',')) {
+                fields.push_back(field);
+            }
+            if (fields.size() < 8 || fields[0] == "matrix_size") {
+                continue;
+            }
+            if (!parseReportField(fields[0], record.matrixSize) || !parseReportField(fields[2], record.grain)) {
+                continue;
+            }
+            record.config = fields[1];
+            record.kernel = fields[3];
+            record.accumulator = fields[4];
+            median = fields[7];
+        }
+        double seconds = 0.0;
+        if (!parseReportField(median, seconds)) {
+            continue;
+        }
+        baseline[record.key()] = seconds;
+    }
+    return !baseline.empty();
+}
+
+#endif //TASK_BENCH_H
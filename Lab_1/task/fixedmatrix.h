@@ -0,0 +1,120 @@
+#ifndef TASK_FIXEDMATRIX_H
+#define TASK_FIXEDMATRIX_H
+
+#include <cstddef>
+#include <type_traits>
+
+#include "kernels.h"
+#include "matrix.h"
+#include "reduce.h"
+
+// Square matrix sizes with a compile-time-width row-sum kernel; anything else
+// takes the generic runtime-sized path. The kernels run on an ordinary
+// Matrix<T> with its padded stride, so no separate storage is involved.
+// There is no 16: the int64 and double kernels work in 32-element blocks, so
+// a 16-wide row has no vector loop to specialize and measured slower.
+template <size_t... Sizes>
+struct FixedSizeList {};
+
+using FixedSizes = FixedSizeList<32, 64, 100, 128>;
+
+// Sums rows [startRow, endRow) of an N-wide matrix with the width and stride
+// known at compile time. Every row goes through the same kernel as the
+// runtime-sized path, but it is called directly from a clone built for the
+// same ISA, so it is inlined with the width constant: the vector loop trip
+// count and the tail fold away and the per-row indirect call disappears.
+template <typename Acc, typename T, size_t N, RowSumFn<Acc, T> RowSum>
+REDUCE_INLINE void fixedRowSumsBody(const T *data, DiagonalView<Acc> out, int startRow, int endRow) {
+    constexpr size_t stride = Matrix<T>::paddedStride(N);
+    for (int i = startRow; i < endRow; ++i) {
+        out[i] = RowSum(data + i * stride, N);
+    }
+}
+
+template <typename Acc, typename T>
+using FixedRowSumsFn = void (*)(const T *data, DiagonalView<Acc> out, int startRow, int endRow);
+
+template <typename Acc, typename T, size_t N>
+void fixedRowSumsBaseline(const T *data, DiagonalView<Acc> out, int startRow, int endRow) {
+    if constexpr (isNarrowElement<T>) {
+        fixedRowSumsBody<Acc, T, N, rowSumNarrowScalar<Acc, T>>(data, out, startRow, endRow);
+    } else {
+        fixedRowSumsBody<Acc, T, N, rowSumScalar<Acc>>(data, out, startRow, endRow);
+    }
+}
+
+#ifdef KERNELS_X86
+
+template <typename Acc, typename T, size_t N>
+KERNEL_TARGET("sse2")
+void fixedRowSumsSse2(const T *data, DiagonalView<Acc> out, int startRow, int endRow) {
+    if constexpr (isNarrowElement<T>) {
+        fixedRowSumsBody<Acc, T, N, rowSumNarrowSse2<Acc, T>>(data, out, startRow, endRow);
+    } else {
+        fixedRowSumsBody<Acc, T, N, rowSumSse2<Acc>>(data, out, startRow, endRow);
+    }
+}
+
+template <typename Acc, typename T, size_t N>
+KERNEL_TARGET("avx2")
+void fixedRowSumsAvx2(const T *data, DiagonalView<Acc> out, int startRow, int endRow) {
+    if constexpr (isNarrowElement<T>) {
+        fixedRowSumsBody<Acc, T, N, rowSumNarrowAvx2<Acc, T>>(data, out, startRow, endRow);
+    } else {
+        fixedRowSumsBody<Acc, T, N, rowSumAvx2<Acc>>(data, out, startRow, endRow);
+    }
+}
+
+template <typename Acc, typename T, size_t N>
+KERNEL_TARGET("avx512f")
+void fixedRowSumsAvx512(const T *data, DiagonalView<Acc> out, int startRow, int endRow) {
+    if constexpr (isNarrowElement<T>) {
+        fixedRowSumsBody<Acc, T, N, rowSumNarrowAvx512<Acc, T>>(data, out, startRow, endRow);
+    } else {
+        fixedRowSumsBody<Acc, T, N, rowSumAvx512<Acc>>(data, out, startRow, endRow);
+    }
+}
+
+#endif
+
+// Same selection as rowSumKernel(): the fixed clone of the kernel the
+// runtime-sized path would use.
+template <typename Acc, typename T, size_t N>
+FixedRowSumsFn<Acc, T> fixedRowSumsKernel(RowSumKernel kernel) {
+    switch (kernel) {
+#ifdef KERNELS_X86
+        case RowSumKernel::Sse2: return fixedRowSumsSse2<Acc, T, N>;
+        case RowSumKernel::Avx2: return fixedRowSumsAvx2<Acc, T, N>;
+        case RowSumKernel::Avx512: return fixedRowSumsAvx512<Acc, T, N>;
+#endif
+        case RowSumKernel::Auto: return fixedRowSumsKernel<Acc, T, N>(detectRowSumKernel());
+        default: return fixedRowSumsBaseline<Acc, T, N>;
+    }
+}
+
+template <typename Visitor, size_t... Sizes>
+bool visitFixedSize(size_t size, Visitor &&visit, FixedSizeList<Sizes...>) {
+    return ((size == Sizes && (visit(std::integral_constant<size_t, Sizes>{}), true)) || ...);
+}
+
+// Calls visit(std::integral_constant<size_t, N>{}) when `size` is one of the
+// fixed sizes, so the caller can instantiate the kernel for that width.
+// Returns false when there is no fixed kernel for `size`.
+template <typename Visitor>
+bool visitFixedSize(size_t size, Visitor &&visit) {
+    return visitFixedSize(size, visit, FixedSizes{});
+}
+
+// The compile-time clone of `kernel` for `matrix` when it is square, one of
+// the fixed sizes and laid out with the padded stride the clones assume (a
+// matrix mapped from a file may not be); nullptr otherwise.
+template <typename Acc, typename T>
+FixedRowSumsFn<Acc, T> fixedRowSumsFor(const Matrix<T> &matrix, RowSumKernel kernel) {
+    FixedRowSumsFn<Acc, T> fixedRowSums = nullptr;
+    if (matrix.rows() == matrix.cols() && matrix.stride() == Matrix<T>::paddedStride(matrix.cols())) {
+        visitFixedSize(matrix.cols(), [&](auto size) { fixedRowSums = fixedRowSumsKernel<Acc, T, decltype(size)::value>(kernel); });
+    }
+    return fixedRowSums;
+}
+
+#endif //TASK_FIXEDMATRIX_H
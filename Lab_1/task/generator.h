@@ -0,0 +1,154 @@
+#ifndef TASK_GENERATOR_H
+#define TASK_GENERATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "kernels.h"
+#include "matrix.h"
+#include "pool.h"
+
+// Counter-based generator: element (i, j) depends only on the seed and its
+// coordinates, so any partitioning of the fill produces the same matrix.
+inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t rowKey(uint64_t seed, uint64_t row) {
+    return splitMix64(splitMix64(seed) + row);
+}
+
+// Maps the high 32 bits of a hash onto [0, maxValue] without a division.
+inline int scaleToRange(uint64_t hash, int maxValue) {
+    return static_cast<int>(((hash >> 32) * (static_cast<uint64_t>(maxValue) + 1)) >> 32);
+}
+
+using FillRowFn = void (*)(int *row, size_t size, uint64_t key, int maxValue);
+
+inline void fillRowScalar(int *row, size_t size, uint64_t key, int maxValue) {
+    for (size_t j = 0; j < size; ++j) {
+        row[j] = scaleToRange(splitMix64(key + j), maxValue);
+    }
+}
+
+#ifdef KERNELS_X86
+
+KERNEL_TARGET("avx2")
+inline __m256i mul64Avx2(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+KERNEL_TARGET("avx2")
+inline __m256i splitMix64Avx2(__m256i x) {
+    const __m256i mul1 = _mm256_set1_epi64x(static_cast<long long>(0xBF58476D1CE4E5B9ull));
+    const __m256i mul2 = _mm256_set1_epi64x(static_cast<long long>(0x94D049BB133111EBull));
+    x = _mm256_add_epi64(x, _mm256_set1_epi64x(static_cast<long long>(0x9E3779B97F4A7C15ull)));
+    x = mul64Avx2(_mm256_xor_si256(x, _mm256_srli_epi64(x, 30)), mul1);
+    x = mul64Avx2(_mm256_xor_si256(x, _mm256_srli_epi64(x, 27)), mul2);
+    return _mm256_xor_si256(x, _mm256_srli_epi64(x, 31));
+}
+
+// Eight values per step: two vectors of four 64-bit counters, each hashed,
+// scaled into range and packed down to 32-bit lanes.
+KERNEL_TARGET("avx2")
+inline void fillRowAvx2(int *row, size_t size, uint64_t key, int maxValue) {
+    const __m256i range = _mm256_set1_epi64x(static_cast<long long>(maxValue) + 1);
+    const __m256i step = _mm256_set1_epi64x(8);
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i counterLo = _mm256_add_epi64(_mm256_set1_epi64x(static_cast<long long>(key)), _mm256_setr_epi64x(0, 1, 2, 3));
+    __m256i counterHi = _mm256_add_epi64(counterLo, _mm256_set1_epi64x(4));
+    size_t j = 0;
+    for (; j + 8 <= size; j += 8) {
+        __m256i lo = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(splitMix64Avx2(counterLo), 32), range), 32);
+        __m256i hi = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(splitMix64Avx2(counterHi), 32), range), 32);
+        __m256i packed = _mm256_permutevar8x32_epi32(_mm256_or_si256(lo, _mm256_slli_epi64(hi, 32)), pack);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(row + j), packed);
+        counterLo = _mm256_add_epi64(counterLo, step);
+        counterHi = _mm256_add_epi64(counterHi, step);
+    }
+    fillRowScalar(row + j, size - j, key + j, maxValue);
+}
+
+#endif
+
+inline FillRowFn fillRowKernel() {
+#ifdef KERNELS_X86
+    if (isKernelSupported(RowSumKernel::Avx2)) {
+        return fillRowAvx2;
+    }
+#endif
+    return fillRowScalar;
+}
+
+// Exact 64-bit row sum, taken while the freshly generated row is still in
+// cache. Deliberately independent of the RowSumKernel family it checks.
+template <typename Elem>
+long long rowChecksum(const Elem *row, size_t size) {
+    long long sum = 0;
+    for (size_t j = 0; j < size; ++j) {
+        sum += row[j];
+    }
+    return sum;
+}
+
+// Fills one row of any element type. Narrow rows are generated as ints in
+// `scratch` and narrowed, so every storage type holds the same values.
+template <typename Elem>
+void fillMatrixRow(FillRowFn fillRow, Elem *row, size_t size, uint64_t key, int maxValue, std::vector<int> &scratch) {
+    if constexpr (std::is_same_v<Elem, int>) {
+        fillRow(row, size, key, maxValue);
+    } else {
+        scratch.resize(size);
+        fillRow(scratch.data(), size, key, maxValue);
+        std::copy(scratch.begin(), scratch.end(), row);
+    }
+}
+
+// When rowSums is given it receives rowChecksum() of every generated row.
+template <typename Elem>
+void generateMatrix(Matrix<Elem> &matrix, uint64_t seed, int maxValue, WorkerPool &pool, int workers,
+                    long long *rowSums = nullptr) {
+    FillRowFn fillRow = fillRowKernel();
+    int rows = static_cast<int>(matrix.rows());
+    workers = std::max(1, std::min(workers, rows));
+    pool.run(workers, [&](int worker) {
+        RowRange range = partitionRows(rows, workers, worker);
+        std::vector<int> scratch;
+        for (int i = range.startRow; i < range.endRow; ++i) {
+            RowView<Elem> row = matrix[i];
+            fillMatrixRow(fillRow, row.data(), row.size(), rowKey(seed, i), maxValue, scratch);
+            if (rowSums) {
+                rowSums[i] = rowChecksum(row.data(), row.size());
+            }
+        }
+    });
+}
+
+// Row checksums of the matrix generateMatrix would produce, without ever
+// holding more than one row per worker.
+template <typename Elem>
+std::vector<long long> generateRowChecksums(size_t rows, size_t cols, uint64_t seed, int maxValue, WorkerPool &pool, int workers) {
+    std::vector<long long> rowSums(rows);
+    FillRowFn fillRow = fillRowKernel();
+    workers = std::max(1, std::min(workers, static_cast<int>(rows)));
+    pool.run(workers, [&](int worker) {
+        RowRange range = partitionRows(static_cast<int>(rows), workers, worker);
+        std::vector<Elem> row(cols);
+        std::vector<int> scratch;
+        for (int i = range.startRow; i < range.endRow; ++i) {
+            fillMatrixRow(fillRow, row.data(), cols, rowKey(seed, i), maxValue, scratch);
+            rowSums[i] = rowChecksum(row.data(), cols);
+        }
+    });
+    return rowSums;
+}
+
+#endif //TASK_GENERATOR_H
@@ -0,0 +1,81 @@
+#ifndef TASK_INCREMENTAL_H
+#define TASK_INCREMENTAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kernels.h"
+#include "matrix.h"
+
+// Row sums of a matrix kept current while the matrix changes. Setting a
+// single cell adjusts its row's cached sum by the difference right away;
+// rows rewritten through updateRow() are marked in a dirty bitmap, logged
+// once each, and summed again by recompute(), which touches no other row.
+template <typename T, typename Acc>
+class IncrementalRowSums {
+public:
+    IncrementalRowSums(Matrix<T> &matrix, RowSumFn<Acc, T> rowSum)
+        : m_matrix(matrix), m_rowSum(rowSum), m_sums(matrix.rows()), m_dirtyBits((matrix.rows() + 63) / 64, 0) {
+        recomputeAll();
+    }
+
+    void setCell(size_t row, size_t col, T value) {
+        T &cell = m_matrix(row, col);
+        if (!isDirty(row)) {
+            m_sums[row] += Acc(value) - Acc(cell);
+        }
+        cell = value;
+    }
+
+    // Writable row; its sum is stale until the next recompute().
+    RowView<T> updateRow(size_t row) {
+        markDirty(row);
+        return m_matrix[row];
+    }
+
+    void markDirty(size_t row) {
+        uint64_t bit = uint64_t(1) << (row % 64);
+        if (!(m_dirtyBits[row / 64] & bit)) {
+            m_dirtyBits[row / 64] |= bit;
+            m_dirtyRows.push_back(row);
+        }
+    }
+
+    bool isDirty(size_t row) const { return (m_dirtyBits[row / 64] >> (row % 64)) & 1; }
+
+    size_t dirtyCount() const { return m_dirtyRows.size(); }
+
+    // Sums the dirty rows again and clears the log. Returns how many rows
+    // were recomputed.
+    size_t recompute() {
+        for (size_t row : m_dirtyRows) {
+            m_sums[row] = m_rowSum(m_matrix[row].data(), m_matrix.cols());
+            m_dirtyBits[row / 64] &= ~(uint64_t(1) << (row % 64));
+        }
+        size_t count = m_dirtyRows.size();
+        m_dirtyRows.clear();
+        return count;
+    }
+
+    void recomputeAll() {
+        for (size_t row = 0; row < m_matrix.rows(); ++row) {
+            m_sums[row] = m_rowSum(m_matrix[row].data(), m_matrix.cols());
+        }
+        m_dirtyBits.assign(m_dirtyBits.size(), 0);
+        m_dirtyRows.clear();
+    }
+
+    const std::vector<Acc> &sums() const { return m_sums; }
+
+    DiagonalView<Acc> diagonal() { return DiagonalView<Acc>(m_sums.data(), m_sums.size(), 1); }
+
+private:
+    Matrix<T> &m_matrix;
+    RowSumFn<Acc, T> m_rowSum;
+    std::vector<Acc> m_sums;
+    std::vector<uint64_t> m_dirtyBits;
+    std::vector<size_t> m_dirtyRows;
+};
+
+#endif //TASK_INCREMENTAL_H
@@ -0,0 +1,643 @@
+#ifndef TASK_KERNELS_H
+#define TASK_KERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(KERNELS_X86) && !defined(_MSC_VER)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNEL_TARGET(isa)
+#endif
+
+enum class RowSumKernel {
+    Auto,
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512,
+};
+
+enum class Accumulator {
+    Int32,
+    Int64,
+    Double,
+};
+
+// Element type the matrix is stored in. The narrow types halve or quarter
+// the bytes streamed per row when the value range allows it.
+enum class Storage {
+    Int32,
+    UInt16,
+    UInt8,
+};
+
+template <typename Acc, typename Elem = int>
+using RowSumFn = Acc (*)(const Elem *row, size_t size);
+
+// How the row sums are written back. Streaming (non-temporal) stores go
+// around the cache, so a diagonal entry of a large result matrix no longer
+// pulls its whole line in for a single element.
+enum class StoreMode {
+    Normal,
+    Streaming,
+};
+
+template <typename Elem>
+constexpr bool isNarrowElement = std::is_same_v<Elem, uint16_t> || std::is_same_v<Elem, uint8_t>;
+
+// A 32-bit lane holding uint16 values is flushed into 64 bits after at most
+// this many elements per row block, so with four or more lanes it never
+// sees more than 2^14 values below 2^16.
+constexpr size_t NarrowFlushElements = size_t(1) << 16;
+
+template <typename Acc>
+constexpr bool isAccumulator = std::is_same_v<Acc, int> || std::is_same_v<Acc, long long> || std::is_same_v<Acc, double>;
+
+template <typename Acc>
+Acc rowSumScalar(const int *row, size_t size) {
+    static_assert(isAccumulator<Acc>, "Unsupported accumulator type");
+    Acc sum = 0;
+    for (size_t j = 0; j < size; ++j) {
+        sum += row[j];
+    }
+    return sum;
+}
+
+// Narrow rows are summed exactly in 64 bits and converted to the accumulator
+// at the end; for int32 this wraps the same way the 32-bit kernels do.
+template <typename Acc, typename Elem>
+Acc rowSumNarrowScalar(const Elem *row, size_t size) {
+    static_assert(isAccumulator<Acc> && isNarrowElement<Elem>, "Unsupported accumulator or element type");
+    unsigned long long sum = 0;
+    for (size_t j = 0; j < size; ++j) {
+        sum += row[j];
+    }
+    return static_cast<Acc>(static_cast<long long>(sum));
+}
+
+#ifdef KERNELS_X86
+
+// Each step consumes four ints. 64-bit and double accumulators widen the
+// lanes into two registers (low/high pair) before adding.
+template <typename Acc>
+KERNEL_TARGET("sse2")
+Acc rowSumSse2(const int *row, size_t size) {
+    static_assert(isAccumulator<Acc>, "Unsupported accumulator type");
+    size_t j = 0;
+    Acc sum;
+    if constexpr (std::is_same_v<Acc, int>) {
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        __m128i acc2 = _mm_setzero_si128();
+        __m128i acc3 = _mm_setzero_si128();
+        for (; j + 16 <= size; j += 16) {
+            acc0 = _mm_add_epi32(acc0, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j)));
+            acc1 = _mm_add_epi32(acc1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 4)));
+            acc2 = _mm_add_epi32(acc2, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 8)));
+            acc3 = _mm_add_epi32(acc3, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 12)));
+        }
+        for (; j + 4 <= size; j += 4) {
+            acc0 = _mm_add_epi32(acc0, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j)));
+        }
+        __m128i acc = _mm_add_epi32(_mm_add_epi32(acc0, acc1), _mm_add_epi32(acc2, acc3));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_cvtsi128_si32(acc);
+    } else if constexpr (std::is_same_v<Acc, long long>) {
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        __m128i acc2 = _mm_setzero_si128();
+        __m128i acc3 = _mm_setzero_si128();
+        for (; j + 8 <= size; j += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 4));
+            __m128i aSign = _mm_srai_epi32(a, 31);
+            __m128i bSign = _mm_srai_epi32(b, 31);
+            acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, aSign));
+            acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, aSign));
+            acc2 = _mm_add_epi64(acc2, _mm_unpacklo_epi32(b, bSign));
+            acc3 = _mm_add_epi64(acc3, _mm_unpackhi_epi32(b, bSign));
+        }
+        __m128i acc = _mm_add_epi64(_mm_add_epi64(acc0, acc1), _mm_add_epi64(acc2, acc3));
+        long long lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+        sum = lanes[0] + lanes[1];
+    } else {
+        __m128d acc0 = _mm_setzero_pd();
+        __m128d acc1 = _mm_setzero_pd();
+        __m128d acc2 = _mm_setzero_pd();
+        __m128d acc3 = _mm_setzero_pd();
+        for (; j + 8 <= size; j += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 4));
+            acc0 = _mm_add_pd(acc0, _mm_cvtepi32_pd(a));
+            acc1 = _mm_add_pd(acc1, _mm_cvtepi32_pd(_mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2))));
+            acc2 = _mm_add_pd(acc2, _mm_cvtepi32_pd(b));
+            acc3 = _mm_add_pd(acc3, _mm_cvtepi32_pd(_mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        __m128d acc = _mm_add_pd(_mm_add_pd(acc0, acc1), _mm_add_pd(acc2, acc3));
+        sum = _mm_cvtsd_f64(_mm_add_sd(acc, _mm_unpackhi_pd(acc, acc)));
+    }
+    for (; j < size; ++j) {
+        sum += row[j];
+    }
+    return sum;
+}
+
+template <typename Acc>
+KERNEL_TARGET("avx2")
+Acc rowSumAvx2(const int *row, size_t size) {
+    static_assert(isAccumulator<Acc>, "Unsupported accumulator type");
+    size_t j = 0;
+    Acc sum;
+    if constexpr (std::is_same_v<Acc, int>) {
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256();
+        __m256i acc3 = _mm256_setzero_si256();
+        for (; j + 32 <= size; j += 32) {
+            acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j)));
+            acc1 = _mm256_add_epi32(acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 8)));
+            acc2 = _mm256_add_epi32(acc2, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 16)));
+            acc3 = _mm256_add_epi32(acc3, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 24)));
+        }
+        for (; j + 8 <= size; j += 8) {
+            acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j)));
+        }
+        __m256i acc = _mm256_add_epi32(_mm256_add_epi32(acc0, acc1), _mm256_add_epi32(acc2, acc3));
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_cvtsi128_si32(half);
+    } else if constexpr (std::is_same_v<Acc, long long>) {
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256();
+        __m256i acc3 = _mm256_setzero_si256();
+        for (; j + 16 <= size; j += 16) {
+            acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j))));
+            acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 4))));
+            acc2 = _mm256_add_epi64(acc2, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 8))));
+            acc3 = _mm256_add_epi64(acc3, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 12))));
+        }
+        __m256i acc = _mm256_add_epi64(_mm256_add_epi64(acc0, acc1), _mm256_add_epi64(acc2, acc3));
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        long long lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), half);
+        sum = lanes[0] + lanes[1];
+    } else {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        __m256d acc2 = _mm256_setzero_pd();
+        __m256d acc3 = _mm256_setzero_pd();
+        for (; j + 16 <= size; j += 16) {
+            acc0 = _mm256_add_pd(acc0, _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j))));
+            acc1 = _mm256_add_pd(acc1, _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 4))));
+            acc2 = _mm256_add_pd(acc2, _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 8))));
+            acc3 = _mm256_add_pd(acc3, _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 12))));
+        }
+        __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    }
+    for (; j < size; ++j) {
+        sum += row[j];
+    }
+    return sum;
+}
+
+template <typename Acc>
+KERNEL_TARGET("avx512f")
+Acc rowSumAvx512(const int *row, size_t size) {
+    static_assert(isAccumulator<Acc>, "Unsupported accumulator type");
+    size_t j = 0;
+    Acc sum;
+    if constexpr (std::is_same_v<Acc, int>) {
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        __m512i acc2 = _mm512_setzero_si512();
+        __m512i acc3 = _mm512_setzero_si512();
+        for (; j + 64 <= size; j += 64) {
+            acc0 = _mm512_add_epi32(acc0, _mm512_loadu_si512(row + j));
+            acc1 = _mm512_add_epi32(acc1, _mm512_loadu_si512(row + j + 16));
+            acc2 = _mm512_add_epi32(acc2, _mm512_loadu_si512(row + j + 32));
+            acc3 = _mm512_add_epi32(acc3, _mm512_loadu_si512(row + j + 48));
+        }
+        for (; j + 16 <= size; j += 16) {
+            acc0 = _mm512_add_epi32(acc0, _mm512_loadu_si512(row + j));
+        }
+        if (j < size) {
+            __mmask16 tail = static_cast<__mmask16>((1u << (size - j)) - 1);
+            acc1 = _mm512_add_epi32(acc1, _mm512_maskz_loadu_epi32(tail, row + j));
+            j = size;
+        }
+        sum = _mm512_reduce_add_epi32(_mm512_add_epi32(_mm512_add_epi32(acc0, acc1), _mm512_add_epi32(acc2, acc3)));
+    } else if constexpr (std::is_same_v<Acc, long long>) {
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        __m512i acc2 = _mm512_setzero_si512();
+        __m512i acc3 = _mm512_setzero_si512();
+        for (; j + 32 <= size; j += 32) {
+            acc0 = _mm512_add_epi64(acc0, _mm512_cvtepi32_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j))));
+            acc1 = _mm512_add_epi64(acc1, _mm512_cvtepi32_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 8))));
+            acc2 = _mm512_add_epi64(acc2, _mm512_cvtepi32_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 16))));
+            acc3 = _mm512_add_epi64(acc3, _mm512_cvtepi32_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 24))));
+        }
+        sum = _mm512_reduce_add_epi64(_mm512_add_epi64(_mm512_add_epi64(acc0, acc1), _mm512_add_epi64(acc2, acc3)));
+    } else {
+        __m512d acc0 = _mm512_setzero_pd();
+        __m512d acc1 = _mm512_setzero_pd();
+        __m512d acc2 = _mm512_setzero_pd();
+        __m512d acc3 = _mm512_setzero_pd();
+        for (; j + 32 <= size; j += 32) {
+            acc0 = _mm512_add_pd(acc0, _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j))));
+            acc1 = _mm512_add_pd(acc1, _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 8))));
+            acc2 = _mm512_add_pd(acc2, _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 16))));
+            acc3 = _mm512_add_pd(acc3, _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 24))));
+        }
+        sum = _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3)));
+    }
+    for (; j < size; ++j) {
+        sum += row[j];
+    }
+    return sum;
+}
+
+KERNEL_TARGET("sse2")
+inline unsigned long long sumU32LanesSse2(__m128i lanes) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i wide = _mm_add_epi64(_mm_unpacklo_epi32(lanes, zero), _mm_unpackhi_epi32(lanes, zero));
+    unsigned long long halves[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(halves), wide);
+    return halves[0] + halves[1];
+}
+
+// uint8 rows go through PSADBW against zero, which sums eight bytes straight
+// into a 64-bit lane. uint16 rows are zero-extended into 32-bit lanes and
+// flushed every NarrowFlushElements.
+template <typename Acc, typename Elem>
+KERNEL_TARGET("sse2")
+Acc rowSumNarrowSse2(const Elem *row, size_t size) {
+    static_assert(isAccumulator<Acc> && isNarrowElement<Elem>, "Unsupported accumulator or element type");
+    const __m128i zero = _mm_setzero_si128();
+    unsigned long long sum = 0;
+    size_t j = 0;
+    if constexpr (std::is_same_v<Elem, uint8_t>) {
+        __m128i acc0 = zero;
+        __m128i acc1 = zero;
+        for (; j + 32 <= size; j += 32) {
+            acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j)), zero));
+            acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 16)), zero));
+        }
+        unsigned long long lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi64(acc0, acc1));
+        sum = lanes[0] + lanes[1];
+    } else {
+        while (j + 16 <= size) {
+            size_t blockEnd = j + std::min(size - j, NarrowFlushElements);
+            __m128i acc0 = zero;
+            __m128i acc1 = zero;
+            __m128i acc2 = zero;
+            __m128i acc3 = zero;
+            for (; j + 16 <= blockEnd; j += 16) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 8));
+                acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(a, zero));
+                acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(a, zero));
+                acc2 = _mm_add_epi32(acc2, _mm_unpacklo_epi16(b, zero));
+                acc3 = _mm_add_epi32(acc3, _mm_unpackhi_epi16(b, zero));
+            }
+            sum += sumU32LanesSse2(_mm_add_epi32(_mm_add_epi32(acc0, acc1), _mm_add_epi32(acc2, acc3)));
+        }
+    }
+    for (; j < size; ++j) {
+        sum += row[j];
+    }
+    return static_cast<Acc>(static_cast<long long>(sum));
+}
+
+template <typename Acc, typename Elem>
+KERNEL_TARGET("avx2")
+Acc rowSumNarrowAvx2(const Elem *row, size_t size) {
+    static_assert(isAccumulator<Acc> && isNarrowElement<Elem>, "Unsupported accumulator or element type");
+    const __m256i zero = _mm256_setzero_si256();
+    unsigned long long sum = 0;
+    size_t j = 0;
+    if constexpr (std::is_same_v<Elem, uint8_t>) {
+        __m256i acc0 = zero;
+        __m256i acc1 = zero;
+        for (; j + 64 <= size; j += 64) {
+            acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j)), zero));
+            acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 32)), zero));
+        }
+        __m256i acc = _mm256_add_epi64(acc0, acc1);
+        unsigned long long lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes),
+                         _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+        sum = lanes[0] + lanes[1];
+    } else {
+        while (j + 32 <= size) {
+            size_t blockEnd = j + std::min(size - j, NarrowFlushElements);
+            __m256i acc0 = zero;
+            __m256i acc1 = zero;
+            __m256i acc2 = zero;
+            __m256i acc3 = zero;
+            for (; j + 32 <= blockEnd; j += 32) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 16));
+                acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(a, zero));
+                acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(a, zero));
+                acc2 = _mm256_add_epi32(acc2, _mm256_unpacklo_epi16(b, zero));
+                acc3 = _mm256_add_epi32(acc3, _mm256_unpackhi_epi16(b, zero));
+            }
+            __m256i acc = _mm256_add_epi32(_mm256_add_epi32(acc0, acc1), _mm256_add_epi32(acc2, acc3));
+            sum += sumU32LanesSse2(_mm256_castsi256_si128(acc)) + sumU32LanesSse2(_mm256_extracti128_si256(acc, 1));
+        }
+    }
+    for (; j < size; ++j) {
+        sum += row[j];
+    }
+    return static_cast<Acc>(static_cast<long long>(sum));
+}
+
+// AVX-512F alone has no byte/word arithmetic, so both narrow types are
+// zero-extended to 32-bit lanes with VPMOVZX on load.
+template <typename Acc, typename Elem>
+KERNEL_TARGET("avx512f")
+Acc rowSumNarrowAvx512(const Elem *row, size_t size) {
+    static_assert(isAccumulator<Acc> && isNarrowElement<Elem>, "Unsupported accumulator or element type");
+    unsigned long long sum = 0;
+    size_t j = 0;
+    while (j + 64 <= size) {
+        size_t blockEnd = j + std::min(size - j, NarrowFlushElements);
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        __m512i acc2 = _mm512_setzero_si512();
+        __m512i acc3 = _mm512_setzero_si512();
+        for (; j + 64 <= blockEnd; j += 64) {
+            if constexpr (std::is_same_v<Elem, uint8_t>) {
+                acc0 = _mm512_add_epi32(acc0, _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j))));
+                acc1 = _mm512_add_epi32(acc1, _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 16))));
+                acc2 = _mm512_add_epi32(acc2, _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 32))));
+                acc3 = _mm512_add_epi32(acc3, _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j + 48))));
+            } else {
+                acc0 = _mm512_add_epi32(acc0, _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j))));
+                acc1 = _mm512_add_epi32(acc1, _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 16))));
+                acc2 = _mm512_add_epi32(acc2, _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 32))));
+                acc3 = _mm512_add_epi32(acc3, _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j + 48))));
+            }
+        }
+        __m512i acc = _mm512_add_epi32(_mm512_add_epi32(acc0, acc1), _mm512_add_epi32(acc2, acc3));
+        __m512i wide = _mm512_add_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(acc)),
+                                        _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(acc, 1)));
+        sum += static_cast<unsigned long long>(_mm512_reduce_add_epi64(wide));
+    }
+    for (; j < size; ++j) {
+        sum += row[j];
+    }
+    return static_cast<Acc>(static_cast<long long>(sum));
+}
+
+inline void cpuid(int leaf, int subleaf, int regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+inline unsigned long long readXcr0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+#endif
+
+inline bool isKernelSupported(RowSumKernel kernel) {
+    if (kernel == RowSumKernel::Scalar || kernel == RowSumKernel::Auto) {
+        return true;
+    }
+#ifdef KERNELS_X86
+    int regs[4];
+    cpuid(0, 0, regs);
+    int maxLeaf = regs[0];
+    cpuid(1, 0, regs);
+    bool sse2 = (regs[3] >> 26) & 1;
+    bool osxsave = (regs[2] >> 27) & 1;
+    bool avx = (regs[2] >> 28) & 1;
+    if (kernel == RowSumKernel::Sse2) {
+        return sse2;
+    }
+    if (!osxsave || !avx || maxLeaf < 7) {
+        return false;
+    }
+    unsigned long long xcr0 = readXcr0();
+    cpuid(7, 0, regs);
+    if (kernel == RowSumKernel::Avx2) {
+        return (xcr0 & 0x6) == 0x6 && ((regs[1] >> 5) & 1);
+    }
+    if (kernel == RowSumKernel::Avx512) {
+        return (xcr0 & 0xE6) == 0xE6 && ((regs[1] >> 16) & 1);
+    }
+#endif
+    return false;
+}
+
+inline RowSumKernel detectRowSumKernel() {
+    for (RowSumKernel kernel : {RowSumKernel::Avx512, RowSumKernel::Avx2, RowSumKernel::Sse2}) {
+        if (isKernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return RowSumKernel::Scalar;
+}
+
+template <typename Acc, typename Elem = int>
+RowSumFn<Acc, Elem> rowSumKernel(RowSumKernel kernel) {
+    if constexpr (isNarrowElement<Elem>) {
+        switch (kernel) {
+#ifdef KERNELS_X86
+            case RowSumKernel::Sse2: return rowSumNarrowSse2<Acc, Elem>;
+            case RowSumKernel::Avx2: return rowSumNarrowAvx2<Acc, Elem>;
+            case RowSumKernel::Avx512: return rowSumNarrowAvx512<Acc, Elem>;
+#endif
+            case RowSumKernel::Auto: return rowSumKernel<Acc, Elem>(detectRowSumKernel());
+            default: return rowSumNarrowScalar<Acc, Elem>;
+        }
+    } else {
+        switch (kernel) {
+#ifdef KERNELS_X86
+            case RowSumKernel::Sse2: return rowSumSse2<Acc>;
+            case RowSumKernel::Avx2: return rowSumAvx2<Acc>;
+            case RowSumKernel::Avx512: return rowSumAvx512<Acc>;
+#endif
+            case RowSumKernel::Auto: return rowSumKernel<Acc>(detectRowSumKernel());
+            default: return rowSumScalar<Acc>;
+        }
+    }
+}
+
+inline const char *kernelName(RowSumKernel kernel) {
+    switch (kernel) {
+        case RowSumKernel::Auto: return "auto";
+        case RowSumKernel::Scalar: return "scalar";
+        case RowSumKernel::Sse2: return "sse2";
+        case RowSumKernel::Avx2: return "avx2";
+        case RowSumKernel::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+inline bool parseKernel(const std::string &name, RowSumKernel &kernel) {
+    for (RowSumKernel candidate : {RowSumKernel::Auto, RowSumKernel::Scalar, RowSumKernel::Sse2,
+                                   RowSumKernel::Avx2, RowSumKernel::Avx512}) {
+        if (name == kernelName(candidate)) {
+            kernel = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline const char *accumulatorName(Accumulator accumulator) {
+    switch (accumulator) {
+        case Accumulator::Int32: return "int32";
+        case Accumulator::Int64: return "int64";
+        case Accumulator::Double: return "double";
+    }
+    return "unknown";
+}
+
+inline bool parseAccumulator(const std::string &name, Accumulator &accumulator) {
+    for (Accumulator candidate : {Accumulator::Int32, Accumulator::Int64, Accumulator::Double}) {
+        if (name == accumulatorName(candidate)) {
+            accumulator = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline const char *storageName(Storage storage) {
+    switch (storage) {
+        case Storage::Int32: return "int32";
+        case Storage::UInt16: return "uint16";
+        case Storage::UInt8: return "uint8";
+    }
+    return "unknown";
+}
+
+inline bool parseStorage(const std::string &name, Storage &storage) {
+    for (Storage candidate : {Storage::Int32, Storage::UInt16, Storage::UInt8}) {
+        if (name == storageName(candidate)) {
+            storage = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Largest element value the storage type can hold.
+inline long long storageMaxValue(Storage storage) {
+    switch (storage) {
+        case Storage::Int32: return 2147483647;
+        case Storage::UInt16: return 65535;
+        case Storage::UInt8: return 255;
+    }
+    return 0;
+}
+
+inline const char *storeModeName(StoreMode mode) {
+    switch (mode) {
+        case StoreMode::Normal: return "normal";
+        case StoreMode::Streaming: return "stream";
+    }
+    return "unknown";
+}
+
+inline bool parseStoreMode(const std::string &name, StoreMode &mode) {
+    for (StoreMode candidate : {StoreMode::Normal, StoreMode::Streaming}) {
+        if (name == storeModeName(candidate)) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr size_t PrefetchLineBytes = 64;
+constexpr size_t PrefetchBlockBytes = 1024;
+
+inline void prefetchRead(uintptr_t address) {
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_prefetch(reinterpret_cast<const char *>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+    __builtin_prefetch(reinterpret_cast<const void *>(address), 0, 3);
+#else
+    (void) address;
+#endif
+}
+
+// Sums a row one PrefetchBlockBytes block at a time, first requesting the
+// lines `distance` bytes ahead of the block. Past the end of the row the
+// requests run on into the row that follows it in memory; prefetches never
+// fault, so running off the last row is harmless.
+template <typename Acc, typename Elem>
+Acc rowSumPrefetched(RowSumFn<Acc, Elem> rowSum, const Elem *row, size_t size, size_t distance) {
+    constexpr size_t blockElements = PrefetchBlockBytes / sizeof(Elem);
+    uintptr_t base = reinterpret_cast<uintptr_t>(row) + distance;
+    Acc sum = Acc(0);
+    for (size_t j = 0; j < size; j += blockElements) {
+        uintptr_t ahead = base + j * sizeof(Elem);
+        for (size_t line = 0; line < PrefetchBlockBytes; line += PrefetchLineBytes) {
+            prefetchRead(ahead + line);
+        }
+        sum += rowSum(row + j, std::min(blockElements, size - j));
+    }
+    return sum;
+}
+
+template <typename Acc>
+inline void storeStreaming(Acc *target, Acc value) {
+#if defined(__x86_64__) || defined(_M_X64)
+    if constexpr (std::is_same_v<Acc, int>) {
+        _mm_stream_si32(target, value);
+    } else {
+        long long bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        _mm_stream_si64(reinterpret_cast<long long *>(target), bits);
+    }
+#else
+    *target = value;
+#endif
+}
+
+// Orders earlier streaming stores before anything the thread does next, such
+// as signalling that its rows are done.
+inline void storeFence() {
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_sfence();
+#endif
+}
+
+#endif //TASK_KERNELS_H
@@ -0,0 +1,313 @@
+#ifndef TASK_LINALG_H
+#define TASK_LINALG_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "kernels.h"
+#include "matrix.h"
+#include "pool.h"
+#include "reduce.h"
+
+// Dense matrix-vector and matrix-matrix products on the same row-major
+// matrices and row partitioning as the row sums (a row sum is a GEMV with a
+// vector of ones). T is the element and accumulator type: int (wrapping),
+// float or double.
+
+// Rows sharing one pass over x in the GEMV, and the independent partial sums
+// kept per row so the inner loop vectorizes without reassociating.
+constexpr int GemvRows = 4;
+constexpr int GemvLanes = 16;
+
+// y[0..rows) += A[0..rows)[0..n) * x[0..n), rows <= MR. Each x element is
+// loaded once for all the rows of the tile.
+template <typename T, int MR>
+REDUCE_INLINE void gemvTileBody(const T *a, size_t lda, const T *x, size_t n, T *y) {
+    T partial[MR][GemvLanes] = {};
+    size_t j = 0;
+    for (; j + GemvLanes <= n; j += GemvLanes) {
+        for (int i = 0; i < MR; ++i) {
+            for (int lane = 0; lane < GemvLanes; ++lane) {
+                partial[i][lane] += a[i * lda + j + lane] * x[j + lane];
+            }
+        }
+    }
+    for (int i = 0; i < MR; ++i) {
+        T sum = T(0);
+        for (size_t k = j; k < n; ++k) {
+            sum += a[i * lda + k] * x[k];
+        }
+        for (int lane = 0; lane < GemvLanes; ++lane) {
+            sum += partial[i][lane];
+        }
+        y[i] += sum;
+    }
+}
+
+// One worker's rows of y = A x, in column blocks of `blockCols` so the slice
+// of x being used stays in cache while the rows stream past.
+template <typename T>
+REDUCE_INLINE void gemvRowsBody(const Matrix<T> &a, const T *x, T *y, RowRange range, size_t blockCols) {
+    size_t cols = a.cols();
+    std::fill(y + range.startRow, y + range.endRow, T(0));
+    for (size_t first = 0; first < cols; first += blockCols) {
+        size_t width = std::min(blockCols, cols - first);
+        int i = range.startRow;
+        for (; i + GemvRows <= range.endRow; i += GemvRows) {
+            gemvTileBody<T, GemvRows>(a[i].data() + first, a.stride(), x + first, width, y + i);
+        }
+        for (; i < range.endRow; ++i) {
+            gemvTileBody<T, 1>(a[i].data() + first, a.stride(), x + first, width, y + i);
+        }
+    }
+}
+
+// GEMM register tile: GemmTileRows rows of C by Tile::Cols columns, held in
+// registers across the whole k loop.
+constexpr int GemmTileRows = 4;
+
+// Cache blocking: a packed kc x nc panel of B is sized to half the per-core
+// cache, and one kc x Tile::Cols strip of it stays in L1. nc is a multiple
+// of every tile width.
+constexpr size_t GemmPanelAlign = 64;
+
+struct GemmBlocking {
+    size_t kc = 256;
+    size_t nc = 512;
+};
+
+template <typename T>
+GemmBlocking gemmBlocking(size_t cacheBytes) {
+    GemmBlocking blocking;
+    size_t panelCols = cacheBytes / 2 / (blocking.kc * sizeof(T));
+    blocking.nc = std::max<size_t>(GemmPanelAlign, panelCols / GemmPanelAlign * GemmPanelAlign);
+    return blocking;
+}
+
+// Portable tile: plain loops over a 16-column strip.
+template <typename T>
+struct ScalarTile {
+    static constexpr int Cols = 16;
+
+    template <int MR>
+    static REDUCE_INLINE void run(const T *a, size_t lda, const T *strip, size_t kc, T *c, size_t ldc, size_t cols) {
+        T acc[MR][Cols] = {};
+        for (size_t k = 0; k < kc; ++k) {
+            const T *bk = strip + k * Cols;
+            for (int i = 0; i < MR; ++i) {
+                T aik = a[i * lda + k];
+                for (int j = 0; j < Cols; ++j) {
+                    acc[i][j] += aik * bk[j];
+                }
+            }
+        }
+        for (int i = 0; i < MR; ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                c[i * ldc + j] += acc[i][j];
+            }
+        }
+    }
+};
+
+#if defined(__GNUC__)
+
+// Tile two SIMD registers wide, written with GCC vector extensions so the
+// same code becomes AVX2 or AVX-512 in the matching target clone. Every step
+// of k loads the strip row once, broadcasts one element of A per row and
+// does one multiply-add per accumulator register.
+template <typename T, size_t VectorBytes>
+struct SimdVector;
+
+template <> struct SimdVector<int, 32> { typedef int type __attribute__((vector_size(32))); };
+template <> struct SimdVector<int, 64> { typedef int type __attribute__((vector_size(64))); };
+template <> struct SimdVector<float, 32> { typedef float type __attribute__((vector_size(32))); };
+template <> struct SimdVector<float, 64> { typedef float type __attribute__((vector_size(64))); };
+template <> struct SimdVector<double, 32> { typedef double type __attribute__((vector_size(32))); };
+template <> struct SimdVector<double, 64> { typedef double type __attribute__((vector_size(64))); };
+
+template <typename T, size_t VectorBytes>
+struct VectorTile {
+    using Vector = typename SimdVector<T, VectorBytes>::type;
+    static constexpr int Lanes = VectorBytes / sizeof(T);
+    static constexpr int Cols = 2 * Lanes;
+
+    template <int MR>
+    static REDUCE_INLINE void run(const T *a, size_t lda, const T *strip, size_t kc, T *c, size_t ldc, size_t cols) {
+        Vector acc0[MR] = {};
+        Vector acc1[MR] = {};
+        for (size_t k = 0; k < kc; ++k) {
+            Vector b0;
+            Vector b1;
+            std::memcpy(&b0, strip + k * Cols, sizeof(b0));
+            std::memcpy(&b1, strip + k * Cols + Lanes, sizeof(b1));
+            for (int i = 0; i < MR; ++i) {
+                // Subtracting zero is exact, so this is a plain broadcast.
+                Vector aik = a[i * lda + k] - Vector{};
+                acc0[i] += aik * b0;
+                acc1[i] += aik * b1;
+            }
+        }
+        for (int i = 0; i < MR; ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                c[i * ldc + j] += j < size_t(Lanes) ? acc0[i][j] : acc1[i][j - Lanes];
+            }
+        }
+    }
+};
+
+// The ISA clones use the vector tile where the compiler has vector
+// extensions; MSVC builds them around the scalar tile instead.
+template <typename T, size_t VectorBytes>
+using SimdTile = VectorTile<T, VectorBytes>;
+
+#else
+
+template <typename T, size_t VectorBytes>
+using SimdTile = ScalarTile<T>;
+
+#endif
+
+// Copies B[k0..k0+kc)[j0..j0+nc) into strips of Cols columns, each strip
+// row-major and contiguous, zero-padding the last strip.
+template <typename T, int Cols>
+REDUCE_INLINE void packPanelBody(const Matrix<T> &b, size_t k0, size_t kc, size_t j0, size_t nc, T *packed) {
+    for (size_t strip = 0; strip < nc; strip += Cols) {
+        size_t width = std::min<size_t>(Cols, nc - strip);
+        for (size_t k = 0; k < kc; ++k) {
+            const T *source = b[k0 + k].data() + j0 + strip;
+            T *target = packed + strip * kc + k * Cols;
+            for (size_t j = 0; j < width; ++j) {
+                target[j] = source[j];
+            }
+            for (size_t j = width; j < size_t(Cols); ++j) {
+                target[j] = T(0);
+            }
+        }
+    }
+}
+
+// One worker's rows of C = A B. The worker packs each B panel into its own
+// buffer, so workers never wait on each other.
+template <typename T, typename Tile>
+REDUCE_INLINE void gemmRowsBody(const Matrix<T> &a, const Matrix<T> &b, Matrix<T> &c, RowRange range, GemmBlocking blocking) {
+    constexpr int cols = Tile::Cols;
+    size_t inner = a.cols();
+    size_t width = b.cols();
+    std::vector<T> packed(blocking.kc * ((blocking.nc + cols - 1) / cols * cols));
+    for (int i = range.startRow; i < range.endRow; ++i) {
+        std::fill(c[i].begin(), c[i].end(), T(0));
+    }
+    for (size_t j0 = 0; j0 < width; j0 += blocking.nc) {
+        size_t nc = std::min(blocking.nc, width - j0);
+        for (size_t k0 = 0; k0 < inner; k0 += blocking.kc) {
+            size_t kc = std::min(blocking.kc, inner - k0);
+            packPanelBody<T, cols>(b, k0, kc, j0, nc, packed.data());
+            int i = range.startRow;
+            for (; i + GemmTileRows <= range.endRow; i += GemmTileRows) {
+                for (size_t strip = 0; strip < nc; strip += cols) {
+                    Tile::template run<GemmTileRows>(a[i].data() + k0, a.stride(), packed.data() + strip * kc, kc,
+                                                     c[i].data() + j0 + strip, c.stride(), std::min<size_t>(cols, nc - strip));
+                }
+            }
+            for (; i < range.endRow; ++i) {
+                for (size_t strip = 0; strip < nc; strip += cols) {
+                    Tile::template run<1>(a[i].data() + k0, a.stride(), packed.data() + strip * kc, kc, c[i].data() + j0 + strip,
+                                          c.stride(), std::min<size_t>(cols, nc - strip));
+                }
+            }
+        }
+    }
+}
+
+// Like the reductions, the bodies are compiled for the baseline ISA, AVX2
+// with FMA and AVX-512, and the widest the CPU supports is picked at run time.
+template <typename T>
+struct DenseKernels {
+    void (*gemvRows)(const Matrix<T> &a, const T *x, T *y, RowRange range, size_t blockCols);
+    void (*gemmRows)(const Matrix<T> &a, const Matrix<T> &b, Matrix<T> &c, RowRange range, GemmBlocking blocking);
+    const char *isa;
+};
+
+template <typename T>
+void gemvRowsBaseline(const Matrix<T> &a, const T *x, T *y, RowRange range, size_t blockCols) {
+    gemvRowsBody(a, x, y, range, blockCols);
+}
+
+template <typename T>
+void gemmRowsBaseline(const Matrix<T> &a, const Matrix<T> &b, Matrix<T> &c, RowRange range, GemmBlocking blocking) {
+    gemmRowsBody<T, ScalarTile<T>>(a, b, c, range, blocking);
+}
+
+#ifdef KERNELS_X86
+
+template <typename T>
+KERNEL_TARGET("avx2,fma")
+void gemvRowsAvx2(const Matrix<T> &a, const T *x, T *y, RowRange range, size_t blockCols) {
+    gemvRowsBody(a, x, y, range, blockCols);
+}
+
+template <typename T>
+KERNEL_TARGET("avx2,fma")
+void gemmRowsAvx2(const Matrix<T> &a, const Matrix<T> &b, Matrix<T> &c, RowRange range, GemmBlocking blocking) {
+    gemmRowsBody<T, SimdTile<T, 32>>(a, b, c, range, blocking);
+}
+
+template <typename T>
+KERNEL_TARGET("avx512f")
+void gemvRowsAvx512(const Matrix<T> &a, const T *x, T *y, RowRange range, size_t blockCols) {
+    gemvRowsBody(a, x, y, range, blockCols);
+}
+
+template <typename T>
+KERNEL_TARGET("avx512f")
+void gemmRowsAvx512(const Matrix<T> &a, const Matrix<T> &b, Matrix<T> &c, RowRange range, GemmBlocking blocking) {
+    gemmRowsBody<T, SimdTile<T, 64>>(a, b, c, range, blocking);
+}
+
+#endif
+
+template <typename T>
+DenseKernels<T> denseKernels() {
+#ifdef KERNELS_X86
+    if (isKernelSupported(RowSumKernel::Avx512)) {
+        return {gemvRowsAvx512<T>, gemmRowsAvx512<T>, "avx512"};
+    }
+    if (isKernelSupported(RowSumKernel::Avx2)) {
+        return {gemvRowsAvx2<T>, gemmRowsAvx2<T>, "avx2"};
+    }
+#endif
+    return {gemvRowsBaseline<T>, gemmRowsBaseline<T>, "baseline"};
+}
+
+// y = A x with the rows of A split into contiguous blocks across the pool.
+// x is walked in column blocks of half of `cacheBytes`.
+template <typename T>
+void gemv(const Matrix<T> &a, const T *x, T *y, WorkerPool &pool, int workers, size_t cacheBytes = 256 * 1024) {
+    int rows = static_cast<int>(a.rows());
+    workers = std::max(1, std::min({workers, rows, pool.size()}));
+    size_t blockCols = std::max<size_t>(GemvLanes, cacheBytes / 2 / sizeof(T) / GemvLanes * GemvLanes);
+    auto gemvRows = denseKernels<T>().gemvRows;
+    pool.run(workers, [&](int worker) {
+        gemvRows(a, x, y, partitionRows(rows, workers, worker), blockCols);
+    });
+}
+
+// C = A B with the rows of C split across the pool in whole register tiles.
+// `cacheBytes` is the per-core cache the B panels are sized for.
+template <typename T>
+void gemm(const Matrix<T> &a, const Matrix<T> &b, Matrix<T> &c, WorkerPool &pool, int workers, size_t cacheBytes = 256 * 1024) {
+    int tiles = static_cast<int>((a.rows() + GemmTileRows - 1) / GemmTileRows);
+    workers = std::max(1, std::min({workers, tiles, pool.size()}));
+    GemmBlocking blocking = gemmBlocking<T>(cacheBytes);
+    auto gemmRows = denseKernels<T>().gemmRows;
+    int rows = static_cast<int>(a.rows());
+    pool.run(workers, [&](int worker) {
+        RowRange tileRange = partitionRows(tiles, workers, worker);
+        RowRange range = {tileRange.startRow * GemmTileRows, std::min(tileRange.endRow * GemmTileRows, rows)};
+        gemmRows(a, b, c, range, blocking);
+    });
+}
+
+#endif //TASK_LINALG_H
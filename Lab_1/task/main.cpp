@@ -1,174 +1,1312 @@
 #include <iostream>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-#include <windows.h>
-#include <intrin.h>
 #include <iomanip>
 
+#include "backend.h"
+#include "bench.h"
+#include "fixedmatrix.h"
+#include "generator.h"
+#include "incremental.h"
+#include "kernels.h"
+#include "linalg.h"
+#include "matrix.h"
+#include "matrixfile.h"
+#include "numa.h"
+#include "perf.h"
+#include "pool.h"
+#include "reduce.h"
+#include "schedule.h"
+#include "stream.h"
+#include "topology.h"
+#include "tuner.h"
+#include "verify.h"
+
 #define SeedNum 7
+#define MaxElementValue 10000
 #define ShouldCheckCorrectness 1
+#define TuningRepetitions 3
 
 using namespace std;
 using chrono::nanoseconds;
 using chrono::duration_cast;
 using chrono::high_resolution_clock;
 
-void printCacheInfo() {
-    int CPUInfo[4];
-    __cpuid(CPUInfo, 0);
-    int nIds = CPUInfo[0];
+enum class FusedMode {
+    Off,
+    Stream,
+    Materialize,
+};
+
+struct Options {
+    RowSumKernel kernel = RowSumKernel::Auto;
+    Accumulator accumulator = Accumulator::Int32;
+    bool pinThreads = true;
+    bool numa = false;
+    bool tune = false;
+    bool forceSweep = false;
+    string profilePath = "tuning_profile.txt";
+    int warmup = 0;
+    int repetitions = 1;
+    string format = "table";
+    string outputPath;
+    string baselinePath;
+    double threshold = 5.0;
+    bool perf = false;
+    string matrixDir;
+    bool diagonalOnly = false;
+    Schedule schedule = Schedule::Static;
+    int grain = 0;
+    bool reductions = false;
+    PagePolicy pages = PagePolicy::Default;
+    Storage storage = Storage::Int32;
+    int maxValue = MaxElementValue;
+    FusedMode fused = FusedMode::Off;
+    bool phases = false;
+    bool stream = true;
+    double churn = 0.0;
+    vector<int> prefetchDistances = {0};
+    vector<StoreMode> storeModes = {StoreMode::Normal};
+    bool dense = false;
+    int gemmMaxSize = 2000;
+    vector<Backend> backends;
+};
+
+void printUsage(const char *program) {
+    cout << "Usage: " << program << " [--kernel=auto|scalar|sse2|avx2|avx512] [--acc=int32|int64|double] [--no-pin] [--numa]"
+         << " [--tune] [--sweep] [--profile=<path>]" << endl
+         << "       [--warmup=N] [--reps=N] [--format=table|csv|json] [--output=<path>] [--baseline=<path>] [--threshold=<percent>]" << endl
+         << "       [--perf] [--matrix-dir=<dir>] [--result=matrix|diagonal] [--schedule=static|dynamic|guided] [--grain=N]" << endl
+         << "       [--reductions] [--pages=4k|thp|2m|1g] [--storage=int32|uint16|uint8] [--max-value=N]" << endl
+         << "       [--fused[=materialize]] [--phases] [--no-stream] [--incremental[=fraction]]" << endl
+         << "       [--prefetch=<bytes>[,<bytes>...]] [--stores=normal|stream|both]" << endl
+         << "       [--dense] [--gemm-max=N] [--backends[=pool|threads|omp-static|omp-dynamic|par-stl,...]]" << endl;
+}
 
-    for (int i = 0; i <= nIds; ++i) {
-        __cpuidex(CPUInfo, i, 0);
-        if (CPUInfo[0] == 4) {
-            int cacheLevel = (CPUInfo[0] >> 5) & 0x7;
-            int cacheType = CPUInfo[0] & 0xFF;
-            if (cacheType == 1 || cacheType == 2 || cacheType == 3) {
-                cout << "Cache Level: " << cacheLevel << ", Type: "
-                     << (cacheType == 1 ? "Data" : (cacheType == 2 ? "Instruction" : "Unified"))
-                     << ", Size: " << ((CPUInfo[1] + 1) * 8) << " KB" << endl;
+bool parseOptions(int argc, char *argv[], Options &options) {
+    bool matrixResult = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--kernel=", 0) == 0) {
+            if (!parseKernel(arg.substr(9), options.kernel)) {
+                cout << "Unknown kernel: " << arg.substr(9) << endl;
+                return false;
+            }
+        } else if (arg.rfind("--acc=", 0) == 0) {
+            if (!parseAccumulator(arg.substr(6), options.accumulator)) {
+                cout << "Unknown accumulator: " << arg.substr(6) << endl;
+                return false;
+            }
+        } else if (arg == "--no-pin") {
+            options.pinThreads = false;
+        } else if (arg == "--numa") {
+            options.numa = true;
+        } else if (arg == "--tune") {
+            options.tune = true;
+        } else if (arg == "--sweep") {
+            options.forceSweep = true;
+        } else if (arg.rfind("--profile=", 0) == 0) {
+            options.profilePath = arg.substr(10);
+        } else if (arg.rfind("--warmup=", 0) == 0) {
+            options.warmup = max(0, atoi(arg.c_str() + 9));
+        } else if (arg.rfind("--reps=", 0) == 0) {
+            options.repetitions = max(1, atoi(arg.c_str() + 7));
+        } else if (arg.rfind("--format=", 0) == 0) {
+            options.format = arg.substr(9);
+            if (options.format != "table" && options.format != "csv" && options.format != "json") {
+                cout << "Unknown format: " << options.format << endl;
+                return false;
+            }
+        } else if (arg.rfind("--output=", 0) == 0) {
+            options.outputPath = arg.substr(9);
+        } else if (arg.rfind("--baseline=", 0) == 0) {
+            options.baselinePath = arg.substr(11);
+        } else if (arg.rfind("--threshold=", 0) == 0) {
+            options.threshold = atof(arg.c_str() + 12);
+        } else if (arg == "--perf") {
+            options.perf = true;
+        } else if (arg.rfind("--matrix-dir=", 0) == 0) {
+            options.matrixDir = arg.substr(13);
+        } else if (arg.rfind("--result=", 0) == 0) {
+            string result = arg.substr(9);
+            if (result != "matrix" && result != "diagonal") {
+                cout << "Unknown result mode: " << result << endl;
+                return false;
+            }
+            options.diagonalOnly = result == "diagonal";
+            matrixResult = result == "matrix";
+        } else if (arg.rfind("--schedule=", 0) == 0) {
+            if (!parseSchedule(arg.substr(11), options.schedule)) {
+                cout << "Unknown schedule: " << arg.substr(11) << endl;
+                return false;
+            }
+        } else if (arg.rfind("--grain=", 0) == 0) {
+            options.grain = max(0, atoi(arg.c_str() + 8));
+        } else if (arg == "--reductions") {
+            options.reductions = true;
+        } else if (arg.rfind("--storage=", 0) == 0) {
+            if (!parseStorage(arg.substr(10), options.storage)) {
+                cout << "Unknown storage: " << arg.substr(10) << endl;
+                return false;
+            }
+        } else if (arg.rfind("--max-value=", 0) == 0) {
+            options.maxValue = max(0, atoi(arg.c_str() + 12));
+        } else if (arg == "--fused") {
+            options.fused = FusedMode::Stream;
+        } else if (arg == "--fused=materialize") {
+            options.fused = FusedMode::Materialize;
+        } else if (arg == "--incremental") {
+            options.churn = 0.001;
+        } else if (arg.rfind("--incremental=", 0) == 0) {
+            options.churn = atof(arg.c_str() + 14);
+            if (options.churn <= 0 || options.churn > 1) {
+                cout << "Changed-row fraction must be in (0, 1]: " << arg.substr(14) << endl;
+                return false;
+            }
+        } else if (arg.rfind("--prefetch=", 0) == 0) {
+            options.prefetchDistances.clear();
+            stringstream list(arg.substr(11));
+            string distance;
+            while (getline(list, distance, ',')) {
+                options.prefetchDistances.push_back(max(0, atoi(distance.c_str())));
+            }
+            if (options.prefetchDistances.empty()) {
+                options.prefetchDistances.push_back(0);
+            }
+        } else if (arg.rfind("--stores=", 0) == 0) {
+            string stores = arg.substr(9);
+            StoreMode mode;
+            if (stores == "both") {
+                options.storeModes = {StoreMode::Normal, StoreMode::Streaming};
+            } else if (parseStoreMode(stores, mode)) {
+                options.storeModes = {mode};
+            } else {
+                cout << "Unknown store mode: " << stores << endl;
+                return false;
+            }
+        } else if (arg == "--dense") {
+            options.dense = true;
+        } else if (arg.rfind("--gemm-max=", 0) == 0) {
+            options.gemmMaxSize = max(0, atoi(arg.c_str() + 11));
+        } else if (arg == "--backends") {
+            options.backends.clear();
+            for (Backend backend : AllBackends) {
+                if (isBackendAvailable(backend)) {
+                    options.backends.push_back(backend);
+                }
             }
+        } else if (arg.rfind("--backends=", 0) == 0) {
+            options.backends.clear();
+            stringstream list(arg.substr(11));
+            string name;
+            while (getline(list, name, ',')) {
+                Backend backend;
+                if (!parseBackend(name, backend)) {
+                    cout << "Unknown backend: " << name << endl;
+                    return false;
+                }
+                if (!isBackendAvailable(backend)) {
+                    cout << "Backend " << name << " is not available in this build" << endl;
+                    return false;
+                }
+                options.backends.push_back(backend);
+            }
+        } else if (arg == "--no-stream") {
+            options.stream = false;
+        } else if (arg == "--phases") {
+            options.phases = true;
+        } else if (arg.rfind("--pages=", 0) == 0) {
+            if (!parsePagePolicy(arg.substr(8), options.pages)) {
+                cout << "Unknown page policy: " << arg.substr(8) << endl;
+                return false;
+            }
+        } else {
+            cout << "Unknown option: " << arg << endl;
+            return false;
+        }
+    }
+    if (options.maxValue > storageMaxValue(options.storage)) {
+        cout << "Values up to " << options.maxValue << " do not fit " << storageName(options.storage) << " storage" << endl;
+        return false;
+    }
+    // A file-backed matrix may not fit in memory, so nothing may copy it:
+    // the row sums go to a diagonal vector, and modes that need their own
+    // full-size matrix are refused.
+    if (!options.matrixDir.empty()) {
+        if (matrixResult) {
+            cout << "--matrix-dir needs --result=diagonal; --result=matrix would copy the mapped matrix for every config" << endl;
+            return false;
+        }
+        if (options.churn > 0 || options.dense) {
+            cout << "--matrix-dir cannot be combined with " << (options.churn > 0 ? "--incremental" : "--dense")
+                 << ", which copies the whole matrix" << endl;
+            return false;
         }
+        options.diagonalOnly = true;
     }
+    return true;
 }
 
-void printSystemInfo(int &cpuNum) {
-    SYSTEM_INFO sysinfo;
-    GetSystemInfo(&sysinfo);
-    cpuNum = sysinfo.dwNumberOfProcessors;
+struct Environment {
+    const Options &options;
+    const Topology &topology;
+    WorkerPool &pool;
+    vector<int> workerNodes;
+    int generatorThreads;
+    StreamBandwidth stream;
+    map<string, double> baseline;
+};
 
-    cout << "System Information:" << endl;
-    cout << "Number of logical processors: " << sysinfo.dwNumberOfProcessors << endl;
-    cout << "Processor architecture: "
-         << (sysinfo.wProcessorArchitecture == PROCESSOR_ARCHITECTURE_INTEL ? "x86" :
-             sysinfo.wProcessorArchitecture == PROCESSOR_ARCHITECTURE_AMD64 ? "x64" : "Unknown")
-         << endl;
-    cout << "Page size: " << sysinfo.dwPageSize << " bytes" << endl;
-    cout << "Minimum application address: " << sysinfo.lpMinimumApplicationAddress << endl;
-    cout << "Maximum application address: " << sysinfo.lpMaximumApplicationAddress << endl;
+struct RunConfig {
+    int threads;
+    int grain;
+    RowSumKernel kernel;
+    Schedule schedule = Schedule::Static;
+    int prefetch = 0;
+    StoreMode stores = StoreMode::Normal;
+};
 
-    MEMORYSTATUSEX memInfo;
-    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-    GlobalMemoryStatusEx(&memInfo);
+// Sweep label for a config: thread count, then any non-default schedule,
+// prefetch distance and store mode.
+string runConfigName(const RunConfig& config) {
+    string name = to_string(config.threads);
+    if (config.schedule != Schedule::Static) {
+        name += string("/") + scheduleName(config.schedule);
+    }
+    if (config.prefetch > 0) {
+        name += "/pf" + to_string(config.prefetch);
+    }
+    if (config.stores == StoreMode::Streaming) {
+        name += "/nt";
+    }
+    return name;
+}
 
-    cout << "Total physical memory: " << memInfo.ullTotalPhys / (1024 * 1024) << " MB" << endl;
-    cout << "Available physical memory: " << memInfo.ullAvailPhys / (1024 * 1024) << " MB" << endl;
+struct RunResult {
+    double seconds = 0.0;
+    vector<vector<RowRange>> numaPlan;
+    PerfCounts perf;
+    double imbalance = 0.0;
+    PhaseTimes phases;
+};
 
-    printCacheInfo();
+// With --matrix-dir the matrix is memory-mapped from a binary file in that
+// directory, which is generated and written the first time a size is used.
+// rowSums receives the exact sum of every row, recorded as it was generated.
+template <typename Elem>
+Matrix<Elem> loadPrimaryMatrix(int matrixSize, Environment& env, vector<long long>& rowSums) {
+    int maxValue = env.options.maxValue;
+    rowSums.assign(matrixSize, 0);
+    if (env.options.matrixDir.empty()) {
+        Matrix<Elem> primaryMatrix(matrixSize, matrixSize, env.options.pages);
+        generateMatrix(primaryMatrix, SeedNum, maxValue, env.pool, env.generatorThreads, rowSums.data());
+        return primaryMatrix;
+    }
+    string path = matrixFilePath(env.options.matrixDir, matrixSize, SeedNum, storageName(env.options.storage));
+    MatrixFileHeader header;
+    Matrix<Elem> primaryMatrix;
+    if (mapMatrixFile(path, header, primaryMatrix, &rowSums) && matrixFileMatches(header, matrixSize, matrixSize, SeedNum, maxValue)) {
+        return primaryMatrix;
+    }
+    auto start = high_resolution_clock::now();
+    if (!writeGeneratedMatrixFile<Elem>(path, matrixSize, matrixSize, SeedNum, maxValue, env.pool, env.generatorThreads) ||
+        !mapMatrixFile(path, header, primaryMatrix, &rowSums)) {
+        cout << "Could not write matrix file " << path << ", generating in memory" << endl;
+        primaryMatrix = Matrix<Elem>(matrixSize, matrixSize, env.options.pages);
+        rowSums.assign(matrixSize, 0);
+        generateMatrix(primaryMatrix, SeedNum, maxValue, env.pool, env.generatorThreads, rowSums.data());
+        return primaryMatrix;
+    }
+    auto end = high_resolution_clock::now();
+    cout << "Wrote " << path << " in " << fixed << setprecision(2) << duration_cast<nanoseconds>(end - start).count() * 1e-9
+         << " s" << endl;
+    return primaryMatrix;
 }
 
-void processMatrixSection(int startRow, int endRow, const vector<vector<int>>& primaryMatrix, vector<vector<int>>& matrix) {
+// With a prefetch distance every row is read in blocks that request the
+// lines that far ahead first; streaming stores write the sums around the cache.
+// Plain passes over a matrix with a compile-time kernel (fixedRowSums set)
+// go through that instead of the per-row calls.
+template <typename Acc, typename Elem>
+void processMatrixSection(int startRow, int endRow, const Matrix<Elem>& primaryMatrix, DiagonalView<Acc> diagonal, RowSumFn<Acc, Elem> rowSum,
+                          int prefetch = 0, StoreMode stores = StoreMode::Normal, FixedRowSumsFn<Acc, Elem> fixedRowSums = nullptr) {
+    if (fixedRowSums && prefetch == 0 && stores == StoreMode::Normal) {
+        fixedRowSums(primaryMatrix.data(), diagonal, startRow, endRow);
+        return;
+    }
     for (int i = startRow; i < endRow; ++i) {
-        int rowSum = 0;
-        for (int j = 0; j < matrix.size(); ++j) {
-            rowSum += primaryMatrix[i][j];
+        RowView<const Elem> row = primaryMatrix[i];
+        Acc sum = prefetch > 0 ? rowSumPrefetched(rowSum, row.data(), row.size(), prefetch) : rowSum(row.data(), row.size());
+        if (stores == StoreMode::Streaming) {
+            storeStreaming(&diagonal[i], sum);
+        } else {
+            diagonal[i] = sum;
         }
-        matrix[i][i] = rowSum;
     }
+    if (stores == StoreMode::Streaming) {
+        storeFence();
+    }
+}
+
+template <typename Acc>
+bool checkMatrixCorrectness(DiagonalView<Acc> diagonal, const vector<long long>& rowSums, Environment& env) {
+    return verifyRowSums(diagonal, rowSums, env.pool, env.generatorThreads) == 0;
 }
 
-bool checkMatrixCorrectness(const vector<vector<int>>& matrix, const vector<vector<int>>& primaryMatrix, int randomRowCount = 10) {
-    vector<int> randomRows;
-    for (int i = 0; i < randomRowCount; ++i) {
-        randomRows.push_back(rand() % matrix.size());
+// Checks the row sums when ShouldCheckCorrectness is set and records how long
+// the check took in phases.verify.
+template <typename Acc>
+bool verifyRun(DiagonalView<Acc> diagonal, const vector<long long>& rowSums, Environment& env, PhaseTimes& phases) {
+    if (!ShouldCheckCorrectness) {
+        return true;
     }
-    bool isCorrect = true;
-    for (auto row : randomRows) {
-        if (row >= matrix.size()) continue;
-        int actualSum = 0;
-        for (int j = 0; j < matrix.size(); ++j) {
-            actualSum += primaryMatrix[row][j];
+    auto start = high_resolution_clock::now();
+    bool correct = checkMatrixCorrectness(diagonal, rowSums, env);
+    auto end = high_resolution_clock::now();
+    phases.verify = duration_cast<nanoseconds>(end - start).count() * 1e-9;
+    return correct;
+}
+
+template <typename Acc, typename Elem>
+void copyMatrixRows(const Matrix<Elem>& source, Matrix<Acc>& target, WorkerPool& pool, int workers) {
+    int rows = static_cast<int>(source.rows());
+    pool.run(workers, [&](int worker) {
+        RowRange range = partitionRows(rows, workers, worker);
+        for (int i = range.startRow; i < range.endRow; ++i) {
+            copy(source[i].begin(), source[i].end(), target[i].begin());
         }
-        if (matrix[row][row] != actualSum) {
-            cout << "Error in row " << row << ": Expected " << actualSum << ", but got " << matrix[row][row] << endl;
-            isCorrect = false;
+    });
+}
+
+template <typename Acc, typename Elem>
+void linearProcessMatrix(const Matrix<Elem>& primaryMatrix, DiagonalView<Acc> diagonal, RowSumFn<Acc, Elem> rowSum,
+                         FixedRowSumsFn<Acc, Elem> fixedRowSums) {
+    if (fixedRowSums) {
+        fixedRowSums(primaryMatrix.data(), diagonal, 0, static_cast<int>(diagonal.size()));
+        return;
+    }
+    for (size_t i = 0; i < diagonal.size(); ++i) {
+        RowView<const Elem> row = primaryMatrix[i];
+        diagonal[i] = rowSum(row.data(), row.size());
+    }
+}
+
+// The row sums land on the diagonal of a full copy of the matrix, or with
+// --result=diagonal in a vector of their own, which skips the per-config copy
+// and keeps peak memory at a single matrix.
+template <typename Acc>
+struct RowSums {
+    Matrix<Acc> matrix;
+    vector<Acc> values;
+
+    DiagonalView<Acc> diagonal() {
+        return values.empty() ? matrix.diagonal() : DiagonalView<Acc>(values.data(), values.size(), 1);
+    }
+};
+
+template <typename Acc, typename Elem>
+RowSums<Acc> makeRowSums(const Matrix<Elem>& primaryMatrix, Environment& env) {
+    RowSums<Acc> sums;
+    if (env.options.diagonalOnly) {
+        sums.values.resize(primaryMatrix.rows());
+    } else {
+        sums.matrix = Matrix<Acc>(primaryMatrix.rows(), primaryMatrix.cols(), env.options.pages);
+        copyMatrixRows(primaryMatrix, sums.matrix, env.pool, env.options.numa ? env.generatorThreads : 1);
+    }
+    return sums;
+}
+
+// Rows handled by worker t: its NUMA plan in NUMA mode, blocks pulled from
+// the shared cursor under a dynamic or guided schedule, otherwise chunks of
+// `grain` rows dealt out round-robin, or one contiguous block when grain is 0.
+template <typename Acc, typename Elem>
+void processWorkerRows(int t, const RunConfig& config, const vector<vector<RowRange>>& numaPlan, RowCursor& cursor,
+                       const Matrix<Elem>& primaryMatrix, DiagonalView<Acc> diagonal, RowSumFn<Acc, Elem> rowSum,
+                       FixedRowSumsFn<Acc, Elem> fixedRowSums) {
+    int rows = static_cast<int>(primaryMatrix.rows());
+    if (!numaPlan.empty()) {
+        for (RowRange range : numaPlan[t]) {
+            processMatrixSection(range.startRow, range.endRow, primaryMatrix, diagonal, rowSum, config.prefetch, config.stores,
+                                 fixedRowSums);
+        }
+    } else if (config.schedule != Schedule::Static) {
+        RowRange block;
+        while (cursor.next(block)) {
+            processMatrixSection(block.startRow, block.endRow, primaryMatrix, diagonal, rowSum, config.prefetch, config.stores,
+                                 fixedRowSums);
         }
+    } else if (config.grain > 0) {
+        for (int startRow = t * config.grain; startRow < rows; startRow += config.threads * config.grain) {
+            processMatrixSection(startRow, min(startRow + config.grain, rows), primaryMatrix, diagonal, rowSum, config.prefetch,
+                                 config.stores, fixedRowSums);
+        }
+    } else {
+        RowRange range = partitionRows(rows, config.threads, t);
+        processMatrixSection(range.startRow, range.endRow, primaryMatrix, diagonal, rowSum, config.prefetch, config.stores,
+                                 fixedRowSums);
     }
-    return isCorrect;
 }
 
-void linearProcessMatrix(vector<vector<int>>& matrix) {
-    for (int i = 0; i < matrix.size(); ++i) {
-        int rowSum = 0;
-        for (int j = 0; j < matrix.size(); ++j) {
-            rowSum += matrix[i][j];
+// With countEvents set, every worker reads its own hardware counters around
+// its share of the rows and the counts are summed into the result. Each
+// worker's start and finish times give the load imbalance and the phase
+// breakdown of the run.
+template <typename Acc, typename Elem>
+RunResult runThreaded(const Matrix<Elem>& primaryMatrix, DiagonalView<Acc> diagonal, const RunConfig& config, Environment& env,
+                      bool countEvents = false) {
+    RowSumFn<Acc, Elem> rowSum = rowSumKernel<Acc, Elem>(config.kernel);
+    FixedRowSumsFn<Acc, Elem> fixedRowSums = fixedRowSumsFor<Acc>(primaryMatrix, config.kernel);
+    RunResult result;
+    if (env.options.numa) {
+        result.numaPlan = numaRowPlan(static_cast<int>(primaryMatrix.rows()), env.generatorThreads, config.threads, env.workerNodes);
+    }
+    RowCursor cursor(static_cast<int>(primaryMatrix.rows()), config.threads, config.grain, config.schedule);
+    vector<PerfCounts> workerCounts(countEvents ? config.threads : 0);
+    PhaseTimer timer(config.threads);
+    timer.dispatch();
+
+    env.pool.run(config.threads, [&](int t) {
+        timer.workerStarted(t);
+        if (countEvents) {
+            PerfCounterSet& counters = PerfCounterSet::forCurrentThread();
+            counters.start();
+            processWorkerRows(t, config, result.numaPlan, cursor, primaryMatrix, diagonal, rowSum, fixedRowSums);
+            workerCounts[t] = counters.stop();
+        } else {
+            processWorkerRows(t, config, result.numaPlan, cursor, primaryMatrix, diagonal, rowSum, fixedRowSums);
         }
-        matrix[i][i] = rowSum;
+        timer.workerFinished(t);
+    });
+
+    result.seconds = timer.joined();
+    result.imbalance = loadImbalance(timer.busySeconds());
+    result.phases = timer.phases();
+    for (const PerfCounts& counts : workerCounts) {
+        result.perf += counts;
     }
+    return result;
 }
 
-int main() {
-    int cpuNum;
-    printSystemInfo(cpuNum);
+void printNodeBandwidth(const vector<vector<RowRange>>& numaPlan, double rowBytes, double elapsed, const Environment& env) {
+    vector<double> nodeBytes(env.topology.numa.nodeCount, 0.0);
+    for (size_t t = 0; t < numaPlan.size(); ++t) {
+        for (RowRange range : numaPlan[t]) {
+            nodeBytes[env.workerNodes[t]] += double(range.endRow - range.startRow) * rowBytes;
+        }
+    }
+    cout << "\t";
+    for (size_t node = 0; node < nodeBytes.size(); ++node) {
+        cout << (node ? " " : "") << node << ":" << setprecision(2) << nodeBytes[node] / elapsed * 1e-9;
+    }
+}
 
-    vector matrixSizes = {
-        100,
-        1000,
-        5000,
-        20000,
-        50000,
-    };
+vector<RowSumKernel> supportedKernels() {
+    vector<RowSumKernel> kernels;
+    for (RowSumKernel kernel : {RowSumKernel::Scalar, RowSumKernel::Sse2, RowSumKernel::Avx2, RowSumKernel::Avx512}) {
+        if (isKernelSupported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
 
-    vector numCPUArr = {
-        cpuNum / 2,
-        cpuNum,
-        cpuNum * 2,
-        cpuNum * 4,
-        cpuNum * 8,
-        cpuNum * 16,
-    };
+// Times every thread count / grain / kernel / prefetch / store combination
+// for one matrix and
+// returns the fastest, each measured as the best of TuningRepetitions runs.
+template <typename Acc, typename Elem>
+TunedConfig tuneMatrixSize(const Matrix<Elem>& primaryMatrix, const vector<int>& numCPUArr, Environment& env) {
+    int matrixSize = static_cast<int>(primaryMatrix.rows());
+    vector<int> grains = env.options.numa ? vector<int>{0} : tuningGrains(env.topology, matrixSize, primaryMatrix.stride() * sizeof(Elem));
+    vector<RowSumKernel> kernels = env.options.kernel == RowSumKernel::Auto ? supportedKernels() : vector<RowSumKernel>{env.options.kernel};
+    RowSums<Acc> sums = makeRowSums<Acc>(primaryMatrix, env);
 
-    cout << "\nTest Results:" << endl;
-    cout << "Matrix Size\tThreads\tTime (seconds)\tCorrect?" << endl;
+    TunedConfig best;
+    best.seconds = -1.0;
+    int tried = 0;
+    for (int threadsCount : numCPUArr) {
+        for (int grain : grains) {
+            for (RowSumKernel kernel : kernels) {
+                for (int prefetch : env.options.prefetchDistances) {
+                    for (StoreMode stores : env.options.storeModes) {
+                        RunConfig config = {threadsCount, grain, kernel, Schedule::Static, prefetch, stores};
+                        double elapsed = -1.0;
+                        for (int rep = 0; rep < TuningRepetitions; ++rep) {
+                            double sample = runThreaded(primaryMatrix, sums.diagonal(), config, env).seconds;
+                            elapsed = elapsed < 0 ? sample : min(elapsed, sample);
+                        }
+                        ++tried;
+                        if (best.seconds < 0 || elapsed < best.seconds) {
+                            best = {threadsCount, grain, kernel, elapsed, prefetch, stores};
+                        }
+                    }
+                }
+            }
+        }
+    }
+    cout << matrixSize << "\t\t" << best.threads << "\t" << best.grain << "\t" << kernelName(best.kernel) << "\t" << best.prefetch
+         << "\t" << storeModeName(best.stores) << "\t" << fixed << setprecision(6) << best.seconds << "\t" << tried << endl;
+    return best;
+}
 
-    for (int matrixSize : matrixSizes) {
-        vector primaryMatrix(matrixSize, vector<int>(matrixSize));
-        srand(SeedNum);
-        for (int i = 0; i < matrixSize; ++i) {
-            for (int j = 0; j < matrixSize; ++j) {
-                primaryMatrix[i][j] = rand() % 10001;
+void printPerfCounts(const PerfCounts& counts, int repetitions) {
+    cout << setprecision(0);
+    for (int e = 0; e < PerfEventCount; ++e) {
+        cout << "\t";
+        if (counts.available[e]) {
+            cout << counts.values[e] / repetitions;
+        } else {
+            cout << "-";
+        }
+    }
+    cout << "\t";
+    if (counts.available[PerfCycles] && counts.available[PerfInstructions]) {
+        cout << setprecision(2) << counts.ipc();
+    } else {
+        cout << "-";
+    }
+}
+
+// Compares the run's read bandwidth with the STREAM read peak measured at
+// startup.
+void rateAgainstPeak(BenchRecord& record, const Environment& env) {
+    if (!env.stream.measured()) {
+        return;
+    }
+    record.peakPercent = record.gbPerSecond() / env.stream.readPeak() * 100.0;
+    record.roofline = rooflineVerdict(record.gbPerSecond(), env.stream.readPeak(), record.bytes, env.topology.lastLevelCacheSize());
+}
+
+void printStats(const BenchStats& stats, const BenchRecord& record, const Options& options) {
+    cout << fixed << setprecision(6) << stats.median << "\t" << (record.correct ? "Yes" : (ShouldCheckCorrectness ? "No" : "Unknown"));
+    bool serial = record.config == "linear";
+    if (serial) {
+        cout << "\t-";
+    } else {
+        cout << "\t" << setprecision(1) << record.imbalance << setprecision(6);
+    }
+    if (options.pages != PagePolicy::Default) {
+        cout << "\t" << record.pages;
+    }
+    if (options.phases) {
+        const PhaseTimes& phases = record.phases;
+        if (serial) {
+            cout << "\t-\t" << phases.compute << "\t-";
+        } else {
+            cout << "\t" << setprecision(1) << phases.dispatch * 1e6 << "\t" << setprecision(6) << phases.compute << "\t"
+                 << setprecision(1) << phases.tail * 1e6 << setprecision(6);
+        }
+        cout << "\t" << phases.verify;
+    }
+    if (options.stream) {
+        cout << "\t" << setprecision(1) << record.peakPercent << "\t" << record.roofline << setprecision(6);
+    }
+    if (options.repetitions > 1) {
+        cout << "\t" << stats.min << "\t" << stats.p95 << "\t" << stats.stddev << "\t" << setprecision(2) << record.gbPerSecond();
+    }
+}
+
+template <typename Acc>
+bool reductionMatches(const vector<Acc>& actual, const vector<Acc>& expected) {
+    for (size_t i = 0; i < expected.size(); ++i) {
+        bool same = is_floating_point<Acc>::value ? fabs(actual[i] - expected[i]) <= 1e-9 * max<Acc>(1, fabs(expected[i]))
+                                                  : actual[i] == expected[i];
+        if (!same) {
+            cout << "Error in " << i << ": Expected " << expected[i] << ", but got " << actual[i] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Times one reduction over the rows and over the columns of the matrix and
+// checks both against a plain serial loop.
+template <typename Op, typename Acc, typename Elem>
+void runReduction(const Matrix<Elem>& primaryMatrix, const string& accumulator, Environment& env, BenchReport& report) {
+    const Options& options = env.options;
+    size_t rows = primaryMatrix.rows();
+    size_t cols = primaryMatrix.cols();
+    vector<Acc> expectedRows(rows, Op::identity());
+    vector<Acc> expectedCols(cols, Op::identity());
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            Acc value = Op::template map<Elem>(primaryMatrix(i, j));
+            expectedRows[i] = Op::combine(expectedRows[i], value);
+            expectedCols[j] = Op::combine(expectedCols[j], value);
+        }
+    }
+    for (Acc& value : expectedRows) {
+        value = Op::finish(value);
+    }
+    for (Acc& value : expectedCols) {
+        value = Op::finish(value);
+    }
+
+    for (bool byColumns : {false, true}) {
+        vector<Acc> results(byColumns ? cols : rows);
+        vector<double> samples = measure(options.warmup, options.repetitions, [&] {
+            auto start = high_resolution_clock::now();
+            if (byColumns) {
+                reduceColumns<Op, Elem, Acc>(primaryMatrix, results.data(), env.pool, env.generatorThreads);
+            } else {
+                reduceRows<Op, Elem, Acc>(primaryMatrix, results.data(), env.pool, env.generatorThreads);
             }
+            auto end = high_resolution_clock::now();
+            return duration_cast<nanoseconds>(end - start).count() * 1e-9;
+        });
+        string config = string(Op::name) + (byColumns ? "-cols" : "-rows");
+        BenchRecord record{static_cast<int>(rows), config, 0, "generic", accumulator, double(rows) * cols * sizeof(Elem),
+                           reductionMatches(results, byColumns ? expectedCols : expectedRows), computeStats(samples), 0.0,
+                           pagePolicyName(primaryMatrix.pagePolicy()), PhaseTimes()};
+        rateAgainstPeak(record, env);
+        cout << rows << "\t\t" << Op::name << "\t" << (byColumns ? "columns" : "rows") << "\t" << fixed << setprecision(6)
+             << record.stats.median << "\t" << (record.correct ? "Yes" : "No") << endl;
+        report.add(record);
+    }
+}
+
+// Exact reference for one row of a dense product, in double: the inputs are
+// small integers, so every product and sum below 2^53 is exact for int,
+// float and double alike.
+template <typename T>
+double denseDot(const T* row, const double* x, size_t n) {
+    double sum = 0.0;
+    for (size_t j = 0; j < n; ++j) {
+        sum += double(row[j]) * x[j];
+    }
+    return sum;
+}
+
+template <typename T>
+bool denseMatches(const vector<T>& actual, const vector<double>& expected) {
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (double(actual[i]) != expected[i]) {
+            cout << "Error in " << i << ": Expected " << expected[i] << ", but got " << actual[i] << endl;
+            return false;
         }
+    }
+    return true;
+}
 
-        {
-            vector<vector<int>> copiedMatrix = primaryMatrix;
+// GEMV and GEMM over the thread sweep on A = primary matrix mod 16, which
+// keeps every result exact in int32 and float. GEMV is checked row by row,
+// GEMM with C = A A against A (A r) for a random 0/1 vector r (Freivalds).
+template <typename T, typename Elem>
+void runDense(const Matrix<Elem>& primaryMatrix, const vector<int>& numCPUArr, const string& type, Environment& env,
+              BenchReport& report) {
+    const Options& options = env.options;
+    size_t n = primaryMatrix.rows();
+    Matrix<T> a(n, n, options.pages);
+    env.pool.run(env.generatorThreads, [&](int worker) {
+        RowRange range = partitionRows(static_cast<int>(n), env.generatorThreads, worker);
+        for (int i = range.startRow; i < range.endRow; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                a(i, j) = T(primaryMatrix(i, j) % 16);
+            }
+        }
+    });
+    vector<T> x(n);
+    vector<double> probe(n);
+    mt19937 random(SeedNum);
+    for (size_t j = 0; j < n; ++j) {
+        x[j] = T(random() % 16);
+        probe[j] = double(random() % 2);
+    }
+    vector<double> expectedGemv(n);
+    vector<double> ar(n);
+    vector<double> aar(n);
+    vector<double> xd(x.begin(), x.end());
+    for (size_t i = 0; i < n; ++i) {
+        expectedGemv[i] = denseDot(a[i].data(), xd.data(), n);
+        ar[i] = denseDot(a[i].data(), probe.data(), n);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        aar[i] = denseDot(a[i].data(), ar.data(), n);
+    }
+    size_t cacheBytes = env.topology.perCoreCacheSize(2);
+    if (cacheBytes == 0) {
+        cacheBytes = size_t(256) * 1024;
+    }
+    const char* isa = denseKernels<T>().isa;
+    bool runGemm = int(n) <= options.gemmMaxSize;
+    Matrix<T> c = runGemm ? Matrix<T>(n, n, options.pages) : Matrix<T>();
+
+    for (int threadsCount : numCPUArr) {
+        vector<T> y(n);
+        vector<double> gemvSamples = measure(options.warmup, options.repetitions, [&] {
             auto start = high_resolution_clock::now();
-            linearProcessMatrix(copiedMatrix);
+            gemv(a, x.data(), y.data(), env.pool, threadsCount, cacheBytes);
             auto end = high_resolution_clock::now();
-            string correctness = ShouldCheckCorrectness ? (checkMatrixCorrectness(copiedMatrix, primaryMatrix) ? "Yes" : "No") : "Unknown";
-            auto elapsed = duration_cast<nanoseconds>(end - start).count() * 1e-9;
-            cout << endl << matrixSize << "\t\tLinear\t" << fixed << setprecision(6) << elapsed << "\t" << correctness << endl;
+            return duration_cast<nanoseconds>(end - start).count() * 1e-9;
+        });
+        BenchRecord gemvRecord{static_cast<int>(n), "gemv/" + to_string(threadsCount), 0, isa, type, double(n) * n * sizeof(T),
+                               denseMatches(y, expectedGemv), computeStats(gemvSamples), 0.0, pagePolicyName(a.pagePolicy()), PhaseTimes()};
+        gemvRecord.flops = 2.0 * n * n;
+        rateAgainstPeak(gemvRecord, env);
+        cout << n << "\t\tgemv\t" << type << "\t" << threadsCount << "\t" << fixed << setprecision(6) << gemvRecord.stats.median
+             << "\t" << setprecision(2) << gemvRecord.gflopsPerSecond() << "\t" << gemvRecord.gbPerSecond() << "\t"
+             << (gemvRecord.correct ? "Yes" : "No") << endl;
+        report.add(gemvRecord);
+
+        if (!runGemm) {
+            continue;
+        }
+        vector<double> gemmSamples = measure(options.warmup, options.repetitions, [&] {
+            auto start = high_resolution_clock::now();
+            gemm(a, a, c, env.pool, threadsCount, cacheBytes);
+            auto end = high_resolution_clock::now();
+            return duration_cast<nanoseconds>(end - start).count() * 1e-9;
+        });
+        vector<double> cr(n);
+        for (size_t i = 0; i < n; ++i) {
+            cr[i] = denseDot(c[i].data(), probe.data(), n);
         }
+        BenchRecord gemmRecord{static_cast<int>(n), "gemm/" + to_string(threadsCount), 0, isa, type, 3.0 * n * n * sizeof(T),
+                               denseMatches(cr, aar), computeStats(gemmSamples), 0.0, pagePolicyName(c.pagePolicy()), PhaseTimes()};
+        gemmRecord.flops = 2.0 * n * n * n;
+        cout << n << "\t\tgemm\t" << type << "\t" << threadsCount << "\t" << fixed << setprecision(6) << gemmRecord.stats.median
+             << "\t" << setprecision(2) << gemmRecord.gflopsPerSecond() << "\t-\t" << (gemmRecord.correct ? "Yes" : "No") << endl;
+        report.add(gemmRecord);
+    }
+}
 
-        for (int i = 0; i < numCPUArr.size(); ++i) {
-            vector<vector<int>> copiedMatrix = primaryMatrix;
-            int threadsCount = numCPUArr[i];
-            vector<thread> threads;
+// Changes a `churn` fraction of the rows of a copy of the matrix, one random
+// cell each, and times keeping the row sums current three ways: summing every
+// row again, marking the changed rows dirty and recomputing only those, and
+// applying each cell's difference to the cached sum.
+template <typename Acc, typename Elem>
+void runIncremental(const Matrix<Elem>& primaryMatrix, RowSumKernel kernel, const string& accumulator, Environment& env,
+                    BenchReport& report) {
+    const Options& options = env.options;
+    Matrix<Elem> working = primaryMatrix;
+    IncrementalRowSums<Elem, Acc> tracker(working, rowSumKernel<Acc, Elem>(kernel));
+    size_t rows = working.rows();
+    size_t cols = working.cols();
+    size_t changedRows = max<size_t>(1, static_cast<size_t>(rows * options.churn));
+    mt19937_64 random(SeedNum);
+    uniform_int_distribution<size_t> pickRow(0, rows - 1);
+    uniform_int_distribution<size_t> pickCol(0, cols - 1);
+    uniform_int_distribution<int> pickValue(0, options.maxValue);
+
+    cout << "Incremental recompute, " << changedRows << " changed row(s) per update:" << endl;
+    cout << "Matrix Size\tUpdate\tTime (seconds)\tSpeedup\tCorrect?" << endl;
+    double fullSeconds = 0.0;
+    for (string mode : {"full", "rows", "deltas"}) {
+        vector<double> samples = measure(options.warmup, options.repetitions, [&] {
             auto start = high_resolution_clock::now();
+            for (size_t n = 0; n < changedRows; ++n) {
+                size_t row = pickRow(random);
+                Elem value = static_cast<Elem>(pickValue(random));
+                if (mode == "deltas") {
+                    tracker.setCell(row, pickCol(random), value);
+                } else {
+                    tracker.updateRow(row)[pickCol(random)] = value;
+                }
+            }
+            if (mode == "full") {
+                tracker.recomputeAll();
+            } else {
+                tracker.recompute();
+            }
+            auto end = high_resolution_clock::now();
+            return duration_cast<nanoseconds>(end - start).count() * 1e-9;
+        });
+
+        vector<long long> expected(rows);
+        env.pool.run(env.generatorThreads, [&](int worker) {
+            RowRange range = partitionRows(static_cast<int>(rows), env.generatorThreads, worker);
+            for (int i = range.startRow; i < range.endRow; ++i) {
+                expected[i] = rowChecksum(as_const(working)[i].data(), cols);
+            }
+        });
+        double touchedBytes = double(mode == "full" ? rows : changedRows) * (mode == "deltas" ? 1 : cols) * sizeof(Elem);
+        BenchRecord record{static_cast<int>(rows), "incremental-" + mode, 0, kernelName(kernel), accumulator, touchedBytes,
+                           verifyRowSums(tracker.diagonal(), expected, env.pool, env.generatorThreads) == 0,
+                           computeStats(samples), 0.0, pagePolicyName(working.pagePolicy()), PhaseTimes()};
+        if (mode == "full") {
+            fullSeconds = record.stats.median;
+        }
+        cout << rows << "\t\t" << mode << "\t" << fixed << setprecision(6) << record.stats.median << "\t" << setprecision(1)
+             << (record.stats.median > 0 ? fullSeconds / record.stats.median : 0.0) << "x\t" << (record.correct ? "Yes" : "No") << endl;
+        report.add(record);
+    }
+}
+
+// Fused mode: every worker generates its rows one L2-sized block at a time
+// and sums the block straight away, so each element is produced and consumed
+// in cache. Blocks go to the worker's scratch matrix, or with a target into
+// the full matrix. scratch[t] must hold blockRows rows.
+template <typename Acc, typename Elem>
+RunResult runFused(Matrix<Elem>* target, vector<Matrix<Elem>>& scratch, int blockRows, DiagonalView<Acc> diagonal,
+                   const RunConfig& config, Environment& env) {
+    RowSumFn<Acc, Elem> rowSum = rowSumKernel<Acc, Elem>(config.kernel);
+    FillRowFn fillRow = fillRowKernel();
+    int rows = static_cast<int>(diagonal.size());
+    int maxValue = env.options.maxValue;
+    RowCursor cursor(rows, config.threads, blockRows, config.schedule);
+    RunResult result;
+    PhaseTimer timer(config.threads);
+    timer.dispatch();
+
+    env.pool.run(config.threads, [&](int t) {
+        timer.workerStarted(t);
+        vector<int> narrowScratch;
+        auto processBlock = [&](int first, int last) {
+            Matrix<Elem>& block = target ? *target : scratch[t];
+            int offset = target ? 0 : first;
+            for (int i = first; i < last; ++i) {
+                RowView<Elem> row = block[i - offset];
+                fillMatrixRow(fillRow, row.data(), row.size(), rowKey(SeedNum, i), maxValue, narrowScratch);
+            }
+            for (int i = first; i < last; ++i) {
+                RowView<const Elem> row = as_const(block)[i - offset];
+                diagonal[i] = rowSum(row.data(), row.size());
+            }
+        };
+        if (config.schedule != Schedule::Static) {
+            RowRange block;
+            while (cursor.next(block)) {
+                for (int first = block.startRow; first < block.endRow; first += blockRows) {
+                    processBlock(first, min(first + blockRows, block.endRow));
+                }
+            }
+        } else {
+            RowRange range = partitionRows(rows, config.threads, t);
+            for (int first = range.startRow; first < range.endRow; first += blockRows) {
+                processBlock(first, min(first + blockRows, range.endRow));
+            }
+        }
+        timer.workerFinished(t);
+    });
+
+    result.seconds = timer.joined();
+    result.imbalance = loadImbalance(timer.busySeconds());
+    result.phases = timer.phases();
+    return result;
+}
+
+template <typename Acc, typename Elem>
+void runFusedTests(int matrixSize, const vector<int>& numCPUArr, RowSumKernel kernel, const string& accumulator, Environment& env,
+                   BenchReport& report) {
+    const Options& options = env.options;
+    bool materialize = options.fused == FusedMode::Materialize;
+    vector<long long> rowSums;
+    if (ShouldCheckCorrectness) {
+        rowSums = generateRowChecksums<Elem>(matrixSize, matrixSize, SeedNum, options.maxValue, env.pool, env.generatorThreads);
+    }
+    Matrix<Elem> target = materialize ? Matrix<Elem>(matrixSize, matrixSize, options.pages) : Matrix<Elem>();
+    // Fault the target in outside the timed runs, first-touched by the
+    // workers the way the NUMA path lays out its rows.
+    if (materialize) {
+        env.pool.run(env.generatorThreads, [&](int worker) {
+            RowRange range = partitionRows(matrixSize, env.generatorThreads, worker);
+            for (int i = range.startRow; i < range.endRow; ++i) {
+                fill(target[i].begin(), target[i].end(), Elem(0));
+            }
+        });
+    }
+    int blockRows = static_cast<int>(min<size_t>(matrixSize, env.topology.cacheBlockRows(Matrix<Elem>::paddedStride(matrixSize) * sizeof(Elem))));
+    double matrixBytes = double(matrixSize) * matrixSize * sizeof(Elem);
+    cout << endl;
 
-            int rowsPerThread = matrixSize / threadsCount;
-            int extraRows = matrixSize % threadsCount;
+    for (int threadsCount : numCPUArr) {
+        RunConfig config = {threadsCount, blockRows, kernel, options.schedule};
+        vector<Matrix<Elem>> scratch;
+        if (!materialize) {
             for (int t = 0; t < threadsCount; ++t) {
-                int startRow = t * rowsPerThread + min(t, extraRows);
-                int endRow = startRow + rowsPerThread + (t < extraRows ? 1 : 0);
-                threads.emplace_back(processMatrixSection, startRow, endRow, ref(primaryMatrix), ref(copiedMatrix));
+                scratch.emplace_back(blockRows, matrixSize, options.pages);
+            }
+            env.pool.run(threadsCount, [&](int t) {
+                for (size_t i = 0; i < scratch[t].rows(); ++i) {
+                    fill(scratch[t][i].begin(), scratch[t][i].end(), Elem(0));
+                }
+            });
+        }
+        vector<Acc> sums(matrixSize);
+        DiagonalView<Acc> diagonal(sums.data(), sums.size(), 1);
+        double imbalance = 0.0;
+        PhaseTimes phases;
+        int call = 0;
+        vector<double> samples = measure(options.warmup, options.repetitions, [&] {
+            RunResult run = runFused(materialize ? &target : nullptr, scratch, blockRows, diagonal, config, env);
+            if (call++ >= options.warmup) {
+                imbalance += run.imbalance;
+                phases += run.phases;
+            }
+            return run.seconds;
+        });
+        phases = phases / options.repetitions;
+        bool correct = verifyRun(diagonal, rowSums, env, phases);
+        string configName = string(materialize ? "fused-materialize/" : "fused/") + to_string(threadsCount);
+        BenchRecord record{matrixSize, configName, blockRows, kernelName(kernel), accumulator, matrixBytes, correct,
+                           computeStats(samples), imbalance / options.repetitions,
+                           pagePolicyName(materialize ? target.pagePolicy() : scratch.front().pagePolicy()), phases};
+        rateAgainstPeak(record, env);
+        cout << matrixSize << "\t\t" << threadsCount << " fused\t";
+        printStats(record.stats, record, options);
+        cout << endl;
+        report.add(record);
+    }
+}
+
+// Runs the same row-sum kernel on every backend in --backends for each thread
+// count and prints their median times side by side, one line per count.
+template <typename Acc, typename Elem>
+void runBackends(const Matrix<Elem>& primaryMatrix, const vector<long long>& rowSums, const vector<int>& numCPUArr,
+                 RowSumKernel kernel, const string& accumulator, Environment& env, BenchReport& report) {
+    const Options& options = env.options;
+    RowSumFn<Acc, Elem> rowSum = rowSumKernel<Acc, Elem>(kernel);
+    FixedRowSumsFn<Acc, Elem> fixedRowSums = fixedRowSumsFor<Acc>(primaryMatrix, kernel);
+    int matrixSize = static_cast<int>(primaryMatrix.rows());
+    double matrixBytes = double(matrixSize) * matrixSize * sizeof(Elem);
+    size_t cacheRows = env.topology.cacheBlockRows(primaryMatrix.stride() * sizeof(Elem));
+
+    cout << "Backends, median time (seconds):" << endl;
+    cout << "Matrix Size\tThreads";
+    for (Backend backend : options.backends) {
+        cout << "\t" << backendName(backend);
+    }
+    cout << "\tCorrect?" << endl;
+    for (int threadsCount : numCPUArr) {
+        int grain = options.grain > 0 ? options.grain : dynamicGrain(matrixSize, threadsCount, cacheRows);
+        cout << matrixSize << "\t\t" << threadsCount;
+        bool allCorrect = true;
+        for (Backend backend : options.backends) {
+            RowSums<Acc> sums = makeRowSums<Acc>(primaryMatrix, env);
+            DiagonalView<Acc> diagonal = sums.diagonal();
+            vector<double> samples = measure(options.warmup, options.repetitions, [&] {
+                auto start = high_resolution_clock::now();
+                runOnBackend(backend, matrixSize, threadsCount, grain, env.pool, [&](int startRow, int endRow) {
+                    processMatrixSection(startRow, endRow, primaryMatrix, diagonal, rowSum, 0, StoreMode::Normal, fixedRowSums);
+                });
+                auto end = high_resolution_clock::now();
+                return duration_cast<nanoseconds>(end - start).count() * 1e-9;
+            });
+            PhaseTimes phases;
+            BenchStats stats = computeStats(samples);
+            phases.compute = stats.mean;
+            bool correct = verifyRun(diagonal, rowSums, env, phases);
+            allCorrect = allCorrect && correct;
+            string configName = string(backendName(backend)) + "/" + to_string(threadsCount);
+            BenchRecord record{matrixSize, configName, backend == Backend::OmpDynamic ? grain : 0, kernelName(kernel), accumulator,
+                               matrixBytes, correct, stats, 0.0, pagePolicyName(primaryMatrix.pagePolicy()), phases};
+            rateAgainstPeak(record, env);
+            cout << "\t" << fixed << setprecision(6) << record.stats.median;
+            report.add(record);
+        }
+        cout << "\t" << (allCorrect ? "Yes" : (ShouldCheckCorrectness ? "No" : "Unknown")) << endl;
+    }
+}
+
+template <typename Acc, typename Elem>
+int runTests(const vector<int>& matrixSizes, const vector<int>& numCPUArr, RowSumKernel kernel, Environment& env) {
+    const Options& options = env.options;
+    RowSumFn<Acc, Elem> rowSum = rowSumKernel<Acc, Elem>(kernel);
+    string host = hostKey(env.topology);
+    string accumulator = accumulatorName(options.accumulator);
+    if (options.storage != Storage::Int32) {
+        accumulator += string("/") + storageName(options.storage);
+    }
+
+    TuningProfile profile;
+    // Always read the existing profile: --tune adds to it and writes it back,
+    // so entries for other sizes and hosts must survive. --sweep only stops
+    // the entries from being used.
+    bool profileLoaded = profile.load(options.profilePath) && !options.forceSweep;
+    if (options.tune) {
+        cout << "\nTuning Results:" << endl;
+        cout << "Matrix Size\tThreads\tGrain\tKernel\tPrefetch\tStores\tTime (seconds)\tConfigs tried" << endl;
+        for (int matrixSize : matrixSizes) {
+            vector<long long> rowSums;
+            Matrix<Elem> primaryMatrix = loadPrimaryMatrix<Elem>(matrixSize, env, rowSums);
+            profile.set(host, accumulator, matrixSize, tuneMatrixSize<Acc>(primaryMatrix, numCPUArr, env));
+        }
+        if (profile.save(options.profilePath)) {
+            cout << "Tuning profile written to " << options.profilePath << endl;
+        } else {
+            cout << "Could not write tuning profile " << options.profilePath << endl;
+        }
+        return 0;
+    }
+    if (profileLoaded) {
+        cout << "Using tuning profile " << options.profilePath << " for host " << host << endl;
+    }
+
+    BenchReport report;
+    cout << "\nTest Results:" << endl;
+    if (options.warmup > 0 || options.repetitions > 1) {
+        cout << options.warmup << " warmup run(s), " << options.repetitions << " timed run(s); time is the median" << endl;
+    }
+    if (options.diagonalOnly) {
+        cout << "Row sums go to a separate diagonal vector; the matrix is not copied per config" << endl;
+    }
+    if (options.perf) {
+        cout << "Performance counters: " << (PerfCounterSet::forCurrentThread().anyAvailable() ? "per-run averages summed over workers" : "unavailable") << endl;
+    }
+    if (options.schedule != Schedule::Static || options.grain > 0) {
+        cout << "Schedule: " << scheduleName(options.schedule) << ", grain "
+             << (options.grain > 0 ? to_string(options.grain) : string("auto")) << " rows" << endl;
+    }
+    if (env.stream.measured()) {
+        cout << "% Peak: read bandwidth against the STREAM reduce peak of " << fixed << setprecision(2) << env.stream.readPeak() << " GB/s" << endl;
+    }
+    if (options.phases) {
+        cout << "Phases: dispatch until the first worker starts, mean per-worker compute, tail from the last worker to the join, verification" << endl;
+    }
+    cout << "Matrix Size\tThreads\tTime (seconds)\tCorrect?\tImbalance %" << (options.pages != PagePolicy::Default ? "\tPages" : "")
+         << (options.phases ? "\tDispatch (us)\tCompute (s)\tTail (us)\tVerify (s)" : "")
+         << (options.stream ? "\t% Peak\tRoofline" : "")
+         << (options.repetitions > 1 ? "\tMin\tP95\tStddev\tGB/s" : "")
+         << (options.perf ? "\tCycles\tInstructions\tLLC misses\tdTLB misses\tCtx switches\tIPC" : "")
+         << (options.numa ? "\tNode bandwidth (GB/s)" : "") << endl;
+
+    if (options.fused != FusedMode::Off) {
+        cout << "Fused generate-and-reduce, " << (options.fused == FusedMode::Materialize ? "rows written to the full matrix" : "matrix never stored")
+             << "; time includes generation" << endl;
+    }
+    for (int matrixSize : matrixSizes) {
+        if (options.fused != FusedMode::Off) {
+            runFusedTests<Acc, Elem>(matrixSize, numCPUArr, kernel, accumulator, env, report);
+            continue;
+        }
+        vector<long long> rowSums;
+        Matrix<Elem> primaryMatrix = loadPrimaryMatrix<Elem>(matrixSize, env, rowSums);
+
+        double matrixBytes = double(matrixSize) * matrixSize * sizeof(Elem);
+
+        {
+            RowSums<Acc> sums = makeRowSums<Acc>(primaryMatrix, env);
+            FixedRowSumsFn<Acc, Elem> fixedRowSums = fixedRowSumsFor<Acc>(primaryMatrix, kernel);
+            PerfCounts perf;
+            int call = 0;
+            vector<double> samples = measure(options.warmup, options.repetitions, [&] {
+                bool countEvents = options.perf && call++ >= options.warmup;
+                PerfCounterSet& counters = PerfCounterSet::forCurrentThread();
+                if (countEvents) {
+                    counters.start();
+                }
+                auto start = high_resolution_clock::now();
+                linearProcessMatrix(primaryMatrix, sums.diagonal(), rowSum, fixedRowSums);
+                auto end = high_resolution_clock::now();
+                if (countEvents) {
+                    perf += counters.stop();
+                }
+                return duration_cast<nanoseconds>(end - start).count() * 1e-9;
+            });
+            PhaseTimes phases;
+            BenchStats stats = computeStats(samples);
+            phases.compute = stats.mean;
+            bool correct = verifyRun(sums.diagonal(), rowSums, env, phases);
+            BenchRecord record{matrixSize, "linear", 0, kernelName(kernel), accumulator, matrixBytes, correct, stats, 0.0,
+                               pagePolicyName(primaryMatrix.pagePolicy()), phases};
+            rateAgainstPeak(record, env);
+            cout << endl << matrixSize << "\t\tLinear\t";
+            printStats(record.stats, record, options);
+            if (options.perf) {
+                printPerfCounts(perf, options.repetitions);
             }
+            cout << endl;
+            report.add(record);
+        }
 
-            for (auto &th : threads) {
-                if (th.joinable()) {
-                    th.join();
+        vector<RunConfig> configs;
+        const TunedConfig* tuned = profileLoaded ? profile.find(host, accumulator, matrixSize) : nullptr;
+        if (tuned && tuned->threads <= env.pool.size()) {
+            configs.push_back({tuned->threads, tuned->grain, tuned->kernel, Schedule::Static, tuned->prefetch, tuned->stores});
+        } else {
+            tuned = nullptr;
+            size_t cacheRows = env.topology.cacheBlockRows(primaryMatrix.stride() * sizeof(Elem));
+            for (int threadsCount : numCPUArr) {
+                int grain = options.grain;
+                if (grain == 0 && options.schedule != Schedule::Static) {
+                    grain = dynamicGrain(matrixSize, threadsCount, cacheRows);
+                }
+                for (int prefetch : options.prefetchDistances) {
+                    for (StoreMode stores : options.storeModes) {
+                        configs.push_back({threadsCount, grain, kernel, options.schedule, prefetch, stores});
+                    }
                 }
             }
+        }
 
-            auto end = high_resolution_clock::now();
-            string correctness = ShouldCheckCorrectness ? (checkMatrixCorrectness(copiedMatrix, primaryMatrix) ? "Yes" : "No") : "Unknown";
-            auto elapsed = duration_cast<nanoseconds>(end - start).count() * 1e-9;
-            cout << matrixSize << "\t\t" << threadsCount << "\t" << fixed << setprecision(6) << elapsed << "\t" << correctness << endl;
+        for (const RunConfig& config : configs) {
+            RowSums<Acc> sums = makeRowSums<Acc>(primaryMatrix, env);
+            RunResult last;
+            PerfCounts perf;
+            double imbalance = 0.0;
+            PhaseTimes phases;
+            int call = 0;
+            vector<double> samples = measure(options.warmup, options.repetitions, [&] {
+                bool timed = call++ >= options.warmup;
+                last = runThreaded(primaryMatrix, sums.diagonal(), config, env, options.perf && timed);
+                perf += last.perf;
+                if (timed) {
+                    imbalance += last.imbalance;
+                    phases += last.phases;
+                }
+                return last.seconds;
+            });
+            phases = phases / options.repetitions;
+            bool correct = verifyRun(sums.diagonal(), rowSums, env, phases);
+            string configName = runConfigName(config);
+            BenchRecord record{matrixSize, configName, config.grain, kernelName(config.kernel), accumulator, matrixBytes, correct,
+                               computeStats(samples), imbalance / options.repetitions, pagePolicyName(primaryMatrix.pagePolicy()),
+                               phases};
+            rateAgainstPeak(record, env);
+            cout << matrixSize << "\t\t" << configName << "\t";
+            printStats(record.stats, record, options);
+            if (options.perf) {
+                printPerfCounts(perf, options.repetitions);
+            }
+            if (options.numa) {
+                printNodeBandwidth(last.numaPlan, double(matrixSize) * sizeof(Elem), record.stats.median, env);
+            }
+            report.add(record);
+            if (tuned) {
+                cout << "\t(tuned: grain " << config.grain << ", kernel " << kernelName(config.kernel) << ", prefetch " << config.prefetch
+                     << ", " << storeModeName(config.stores) << " stores)";
+            }
+            cout << endl;
+        }
+
+        if (!options.backends.empty()) {
+            runBackends<Acc>(primaryMatrix, rowSums, numCPUArr, kernel, accumulator, env, report);
+        }
+
+        if (options.reductions) {
+            cout << "Reductions on " << env.generatorThreads << " thread(s):" << endl;
+            cout << "Matrix Size\tReduction\tAxis\tTime (seconds)\tCorrect?" << endl;
+            runReduction<SumOp<long long>, long long>(primaryMatrix, "int64", env, report);
+            runReduction<MinOp<int>, int>(primaryMatrix, "int32", env, report);
+            runReduction<MaxOp<int>, int>(primaryMatrix, "int32", env, report);
+            runReduction<L1NormOp<long long>, long long>(primaryMatrix, "int64", env, report);
+            runReduction<L2NormOp<double>, double>(primaryMatrix, "double", env, report);
+            runReduction<CountOp<long long>, long long>(primaryMatrix, "int64", env, report);
+        }
+
+        if (options.churn > 0) {
+            runIncremental<Acc>(primaryMatrix, kernel, accumulator, env, report);
+        }
+
+        if (options.dense) {
+            cout << "Dense kernels on values 0..15" << (matrixSize > options.gemmMaxSize ? " (GEMM skipped above --gemm-max)" : "") << ":" << endl;
+            cout << "Matrix Size\tKernel\tType\tThreads\tTime (seconds)\tGFLOP/s\tGB/s\tCorrect?" << endl;
+            runDense<int>(primaryMatrix, numCPUArr, "int32", env, report);
+            runDense<float>(primaryMatrix, numCPUArr, "float", env, report);
+            runDense<double>(primaryMatrix, numCPUArr, "double", env, report);
         }
     }
 
+    if (options.format != "table") {
+        if (!options.outputPath.empty()) {
+            cout << "\nWriting " << options.format << " report to " << options.outputPath << endl;
+        } else {
+            cout << endl;
+        }
+        if (!report.write(options.format, options.outputPath)) {
+            cout << "Could not write report " << options.outputPath << endl;
+        }
+    }
+
+    if (!options.baselinePath.empty()) {
+        return report.compare(env.baseline, options.threshold);
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+template <typename Acc>
+int runTestsForStorage(const vector<int>& matrixSizes, const vector<int>& numCPUArr, RowSumKernel kernel, Environment& env) {
+    switch (env.options.storage) {
+        case Storage::UInt16: return runTests<Acc, uint16_t>(matrixSizes, numCPUArr, kernel, env);
+        case Storage::UInt8: return runTests<Acc, uint8_t>(matrixSizes, numCPUArr, kernel, env);
+        default: return runTests<Acc, int>(matrixSizes, numCPUArr, kernel, env);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    // Read the baseline up front so a bad path or file fails before any run.
+    map<string, double> baseline;
+    if (!options.baselinePath.empty() && !loadBaseline(options.baselinePath, baseline)) {
+        cout << "Could not read baseline " << options.baselinePath << endl;
+        return 1;
+    }
+
+    Topology topology = probeTopology();
+    printTopology(topology);
+
+    RowSumKernel kernel = options.kernel == RowSumKernel::Auto ? detectRowSumKernel() : options.kernel;
+    if (!isKernelSupported(kernel)) {
+        cout << "Row-sum kernel " << kernelName(kernel) << " is not supported by this CPU" << endl;
+        return 1;
+    }
+    cout << "Row-sum kernel: " << kernelName(kernel) << (options.kernel == RowSumKernel::Auto ? " (detected)" : " (forced)") << endl;
+    cout << "Accumulator: " << accumulatorName(options.accumulator) << endl;
+    if (options.storage != Storage::Int32 || options.maxValue != MaxElementValue) {
+        cout << "Storage: " << storageName(options.storage) << ", values 0.." << options.maxValue << endl;
+    }
+
+    vector matrixSizes = {
+        100,
+        1000,
+        5000,
+        20000,
+        50000,
+    };
+
+    vector<int> numCPUArr = topology.sweepThreadCounts();
+
+    vector<int> workerCpus;
+    if (options.numa) {
+        workerCpus = interleavedCpuOrder(topology.numa);
+        cout << "NUMA mode: first-touch allocation and node-local rows" << endl;
+    } else if (options.pinThreads) {
+        workerCpus = sequentialCpuOrder();
+    }
+    WorkerPool pool(*max_element(numCPUArr.begin(), numCPUArr.end()), workerCpus);
+    if (options.perf) {
+        // Open every worker's counters now, so the perf_event_open calls are
+        // not paid inside the first timed run.
+        PerfCounterSet::forCurrentThread();
+        pool.run(pool.size(), [](int) { PerfCounterSet::forCurrentThread(); });
+    }
+
+    Environment env{options, topology, pool, vector<int>(pool.size(), 0), min(pool.size(), topology.logicalCpus), StreamBandwidth(),
+                    move(baseline)};
+    for (int t = 0; t < pool.size(); ++t) {
+        int cpu = pool.cpuOf(t);
+        env.workerNodes[t] = cpu >= 0 && size_t(cpu) < topology.numa.cpuNode.size() ? topology.numa.cpuNode[cpu] : 0;
+    }
+    if (options.stream) {
+        env.stream = probeStreamBandwidth(pool, env.generatorThreads, streamArrayBytes(topology));
+        cout << "STREAM bandwidth (" << env.stream.threads << " thread(s), " << env.stream.arrayBytes / (1024 * 1024) << " MB arrays):";
+        for (int kernel = 0; kernel < StreamKernelCount; ++kernel) {
+            cout << (kernel ? ", " : " ") << streamKernelName(kernel) << " " << fixed << setprecision(2) << env.stream.gbPerSecond[kernel];
+        }
+        cout << " GB/s" << endl;
+    }
+
+    int regressions = 0;
+    switch (options.accumulator) {
+        case Accumulator::Int32: regressions = runTestsForStorage<int>(matrixSizes, numCPUArr, kernel, env); break;
+        case Accumulator::Int64: regressions = runTestsForStorage<long long>(matrixSizes, numCPUArr, kernel, env); break;
+        case Accumulator::Double: regressions = runTestsForStorage<double>(matrixSizes, numCPUArr, kernel, env); break;
+    }
+
+    return regressions > 0 ? 2 : 0;
+}
@@ -0,0 +1,160 @@
+#ifndef TASK_MATRIX_H
+#define TASK_MATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "pages.h"
+
+constexpr size_t MatrixAlignment = 64;
+
+template <typename T>
+class RowView {
+public:
+    RowView(T *data, size_t size) : m_data(data), m_size(size) {}
+
+    T &operator[](size_t j) const { return m_data[j]; }
+
+    T *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    T *begin() const { return m_data; }
+    T *end() const { return m_data + m_size; }
+
+private:
+    T *m_data;
+    size_t m_size;
+};
+
+// Strided view of a matrix diagonal, or of a plain vector when step is 1.
+template <typename T>
+class DiagonalView {
+public:
+    DiagonalView(T *data, size_t size, size_t step) : m_data(data), m_size(size), m_step(step) {}
+
+    T &operator[](size_t i) const { return m_data[i * m_step]; }
+
+    size_t size() const { return m_size; }
+
+private:
+    T *m_data;
+    size_t m_size;
+    size_t m_step;
+};
+
+// Row-major matrix in a single aligned allocation. Every row starts on a
+// MatrixAlignment boundary, so stride() may be larger than cols(). The
+// storage is usually owned heap memory, but adopt() can wrap any block (for
+// example a file mapping) together with the handle that releases it. A page
+// policy asks for huge-page backing; copies request the same policy.
+template <typename T>
+class Matrix {
+    static_assert(std::is_trivially_copyable_v<T>, "Matrix elements must be trivially copyable");
+
+public:
+    Matrix() = default;
+
+    Matrix(size_t rows, size_t cols, PagePolicy pages = PagePolicy::Default)
+        : m_rows(rows), m_cols(cols), m_stride(paddedStride(cols)), m_requestedPages(pages),
+          m_storage(allocate(rows * m_stride, pages, m_pages)), m_data(static_cast<T *>(m_storage.get())) {}
+
+    // The copy always gets the padded stride; a source adopted with a wider
+    // stride is copied row by row and its extra padding dropped.
+    Matrix(const Matrix &other) : Matrix(other.m_rows, other.m_cols, other.m_requestedPages) {
+        if (!m_data) {
+            return;
+        }
+        if (other.m_stride == m_stride) {
+            std::memcpy(m_data, other.m_data, sizeInBytes());
+            return;
+        }
+        for (size_t i = 0; i < m_rows; ++i) {
+            std::memcpy(m_data + i * m_stride, other.m_data + i * other.m_stride, m_cols * sizeof(T));
+            std::memset(m_data + i * m_stride + m_cols, 0, (m_stride - m_cols) * sizeof(T));
+        }
+    }
+
+    template <typename U>
+    explicit Matrix(const Matrix<U> &other) : Matrix(other.rows(), other.cols(), other.requestedPagePolicy()) {
+        for (size_t i = 0; i < m_rows; ++i) {
+            std::copy(other[i].begin(), other[i].end(), (*this)[i].begin());
+        }
+    }
+
+    Matrix(Matrix &&other) noexcept { swap(other); }
+
+    Matrix &operator=(Matrix other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    static Matrix adopt(size_t rows, size_t cols, size_t stride, T *data, std::shared_ptr<void> storage) {
+        Matrix matrix;
+        matrix.m_rows = rows;
+        matrix.m_cols = cols;
+        matrix.m_stride = stride;
+        matrix.m_storage = std::move(storage);
+        matrix.m_data = data;
+        return matrix;
+    }
+
+    void swap(Matrix &other) noexcept {
+        std::swap(m_rows, other.m_rows);
+        std::swap(m_cols, other.m_cols);
+        std::swap(m_stride, other.m_stride);
+        std::swap(m_requestedPages, other.m_requestedPages);
+        std::swap(m_pages, other.m_pages);
+        std::swap(m_storage, other.m_storage);
+        std::swap(m_data, other.m_data);
+    }
+
+    RowView<T> operator[](size_t i) { return {m_data + i * m_stride, m_cols}; }
+    RowView<const T> operator[](size_t i) const { return {m_data + i * m_stride, m_cols}; }
+
+    RowView<T> row(size_t i) { return (*this)[i]; }
+    RowView<const T> row(size_t i) const { return (*this)[i]; }
+
+    DiagonalView<T> diagonal() { return {m_data, std::min(m_rows, m_cols), m_stride + 1}; }
+
+    T &operator()(size_t i, size_t j) { return m_data[i * m_stride + j]; }
+    const T &operator()(size_t i, size_t j) const { return m_data[i * m_stride + j]; }
+
+    size_t rows() const { return m_rows; }
+    size_t cols() const { return m_cols; }
+    size_t stride() const { return m_stride; }
+    size_t sizeInBytes() const { return m_rows * m_stride * sizeof(T); }
+
+    PagePolicy pagePolicy() const { return m_pages; }
+    PagePolicy requestedPagePolicy() const { return m_requestedPages; }
+
+    T *data() { return m_data; }
+    const T *data() const { return m_data; }
+
+    static constexpr size_t paddedStride(size_t cols) {
+        constexpr size_t perLine = MatrixAlignment / sizeof(T) > 0 ? MatrixAlignment / sizeof(T) : 1;
+        return (cols + perLine - 1) / perLine * perLine;
+    }
+
+private:
+    static std::shared_ptr<void> allocate(size_t count, PagePolicy requested, PagePolicy &granted) {
+        if (count == 0) {
+            return nullptr;
+        }
+        return allocatePages(count * sizeof(T), MatrixAlignment, requested, granted);
+    }
+
+    size_t m_rows = 0;
+    size_t m_cols = 0;
+    size_t m_stride = 0;
+    PagePolicy m_requestedPages = PagePolicy::Default;
+    PagePolicy m_pages = PagePolicy::Default;
+    std::shared_ptr<void> m_storage;
+    T *m_data = nullptr;
+};
+
+#endif //TASK_MATRIX_H
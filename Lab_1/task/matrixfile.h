@@ -0,0 +1,199 @@
+#ifndef TASK_MATRIXFILE_H
+#define TASK_MATRIXFILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MATRIXFILE_MMAP
+#endif
+
+#include "generator.h"
+#include "matrix.h"
+#include "pool.h"
+
+constexpr char MatrixFileMagic[8] = {'L', '1', 'M', 'A', 'T', 'R', 'I', 'X'};
+constexpr uint32_t MatrixFileVersion = 2;
+constexpr uint64_t MatrixFileDataAlignment = 4096;
+
+template <typename T>
+constexpr uint32_t elementTypeCode() {
+    if constexpr (std::is_same_v<T, int32_t>) {
+        return 1;
+    } else if constexpr (std::is_same_v<T, uint16_t>) {
+        return 2;
+    } else if constexpr (std::is_same_v<T, uint8_t>) {
+        return 3;
+    } else {
+        return 0;
+    }
+}
+
+// Fixed-size header at offset 0, in host byte order. Row data starts at
+// dataOffset (page aligned) and keeps the in-memory padded stride, so a
+// mapped file can be used as a Matrix without copying. The 64-bit row
+// checksums recorded during generation follow at checksumOffset.
+struct MatrixFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t elementType;
+    uint32_t elementSize;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t stride;
+    uint64_t seed;
+    int64_t maxValue;
+    uint64_t dataOffset;
+    uint64_t checksumOffset;
+};
+
+inline std::string matrixFilePath(const std::string &directory, int matrixSize, uint64_t seed, const std::string &type = "int32") {
+    std::string path = directory;
+    if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+        path += '/';
+    }
+    return path + "matrix_" + std::to_string(matrixSize) + "_seed" + std::to_string(seed) + (type == "int32" ? "" : "_" + type) + ".bin";
+}
+
+inline bool matrixFileMatches(const MatrixFileHeader &header, uint64_t rows, uint64_t cols, uint64_t seed, int maxValue) {
+    return header.rows == rows && header.cols == cols && header.seed == seed && header.maxValue == maxValue;
+}
+
+// Generates the matrix block by block straight into the file, so it never
+// needs to fit in memory. The file is written under a temporary name and
+// renamed at the end, so an interrupted run never leaves a valid-looking file.
+template <typename Elem>
+bool writeGeneratedMatrixFile(const std::string &path, size_t rows, size_t cols, uint64_t seed, int maxValue,
+                              WorkerPool &pool, int workers, size_t blockBytes = size_t(64) << 20) {
+    MatrixFileHeader header = {};
+    std::memcpy(header.magic, MatrixFileMagic, sizeof(header.magic));
+    header.version = MatrixFileVersion;
+    header.elementType = elementTypeCode<Elem>();
+    header.elementSize = sizeof(Elem);
+    header.rows = rows;
+    header.cols = cols;
+    header.stride = Matrix<Elem>::paddedStride(cols);
+    header.seed = seed;
+    header.maxValue = maxValue;
+    header.dataOffset = MatrixFileDataAlignment;
+    header.checksumOffset = header.dataOffset + rows * header.stride * sizeof(Elem);
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    std::vector<char> prefix(header.dataOffset, 0);
+    std::memcpy(prefix.data(), &header, sizeof(header));
+    file.write(prefix.data(), prefix.size());
+
+    size_t rowBytes = header.stride * sizeof(Elem);
+    size_t blockRows = std::max<size_t>(1, std::min(rows, blockBytes / std::max<size_t>(rowBytes, 1)));
+    Matrix<Elem> block(blockRows, cols);
+    std::memset(block.data(), 0, block.sizeInBytes());
+    std::vector<long long> rowSums(rows);
+    FillRowFn fillRow = fillRowKernel();
+    for (size_t first = 0; first < rows && file; first += blockRows) {
+        int count = static_cast<int>(std::min(blockRows, rows - first));
+        int blockWorkers = std::max(1, std::min(workers, count));
+        pool.run(blockWorkers, [&](int worker) {
+            RowRange range = partitionRows(count, blockWorkers, worker);
+            std::vector<int> scratch;
+            for (int i = range.startRow; i < range.endRow; ++i) {
+                fillMatrixRow(fillRow, block[i].data(), cols, rowKey(seed, first + i), maxValue, scratch);
+                rowSums[first + i] = rowChecksum(block[i].data(), cols);
+            }
+        });
+        file.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(count * rowBytes));
+    }
+    file.write(reinterpret_cast<const char *>(rowSums.data()), static_cast<std::streamsize>(rows * sizeof(long long)));
+    file.close();
+    if (!file) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+// Maps a matrix file read-only and faults every page in up front, so the
+// first timed pass over it does not absorb the page-ins. The returned matrix
+// keeps the mapping alive; writing to it faults. Without mmap the rows are
+// read into an ordinary matrix instead.
+// The recorded row checksums are copied into rowSums when it is given.
+template <typename T>
+bool mapMatrixFile(const std::string &path, MatrixFileHeader &header, Matrix<T> &matrix,
+                   std::vector<long long> *rowSums = nullptr) {
+    std::ifstream probe(path, std::ios::binary);
+    if (!probe || !probe.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        return false;
+    }
+    if (std::memcmp(header.magic, MatrixFileMagic, sizeof(header.magic)) != 0 || header.version != MatrixFileVersion ||
+        header.elementType != elementTypeCode<T>() || header.elementSize != sizeof(T) || header.stride < header.cols ||
+        header.dataOffset % MatrixAlignment != 0 || header.stride * sizeof(T) % MatrixAlignment != 0) {
+        return false;
+    }
+    uint64_t dataBytes = header.rows * header.stride * sizeof(T);
+    if (rowSums) {
+        rowSums->resize(header.rows);
+        if (header.checksumOffset < header.dataOffset + dataBytes ||
+            !probe.seekg(static_cast<std::streamoff>(header.checksumOffset)) ||
+            !probe.read(reinterpret_cast<char *>(rowSums->data()), static_cast<std::streamsize>(header.rows * sizeof(long long)))) {
+            return false;
+        }
+    }
+    probe.close();
+
+#ifdef MATRIXFILE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || uint64_t(info.st_size) < header.dataOffset + dataBytes) {
+        close(fd);
+        return false;
+    }
+    size_t length = static_cast<size_t>(info.st_size);
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void *base = mmap(nullptr, length, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    madvise(base, length, MADV_WILLNEED);
+    std::shared_ptr<void> mapping(base, [length](void *address) { munmap(address, length); });
+    T *data = reinterpret_cast<T *>(static_cast<char *>(base) + header.dataOffset);
+    matrix = Matrix<T>::adopt(header.rows, header.cols, header.stride, data, std::move(mapping));
+    return true;
+#else
+    if (header.stride != Matrix<T>::paddedStride(header.cols)) {
+        return false;
+    }
+    std::ifstream file(path, std::ios::binary);
+    Matrix<T> loaded(header.rows, header.cols);
+    if (!file.seekg(static_cast<std::streamoff>(header.dataOffset)) ||
+        !file.read(reinterpret_cast<char *>(loaded.data()), static_cast<std::streamsize>(dataBytes))) {
+        return false;
+    }
+    matrix = std::move(loaded);
+    return true;
+#endif
+}
+
+#endif //TASK_MATRIXFILE_H
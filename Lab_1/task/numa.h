@@ -0,0 +1,113 @@
+#ifndef TASK_NUMA_H
+#define TASK_NUMA_H
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <filesystem>
+#endif
+
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#include "pool.h"
+
+struct NumaLayout {
+    int nodeCount = 1;
+    std::vector<int> cpuNode;
+    std::string source = "none";
+};
+
+inline NumaLayout probeNumaLayout() {
+    NumaLayout layout;
+    int cpuCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    layout.cpuNode.assign(cpuCount, 0);
+#ifdef HAVE_LIBNUMA
+    if (numa_available() >= 0) {
+        layout.nodeCount = std::max(1, numa_num_configured_nodes());
+        for (int cpu = 0; cpu < cpuCount; ++cpu) {
+            layout.cpuNode[cpu] = std::max(0, numa_node_of_cpu(cpu));
+        }
+        layout.source = "libnuma";
+        return layout;
+    }
+#endif
+#if defined(__linux__)
+    namespace fs = std::filesystem;
+    std::error_code error;
+    for (int cpu = 0; cpu < cpuCount; ++cpu) {
+        fs::path cpuDir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        for (fs::directory_iterator it(cpuDir, error), end; !error && it != end; it.increment(error)) {
+            std::string name = it->path().filename().string();
+            if (name.rfind("node", 0) == 0 && name.size() > 4) {
+                layout.cpuNode[cpu] = std::stoi(name.substr(4));
+                layout.nodeCount = std::max(layout.nodeCount, layout.cpuNode[cpu] + 1);
+                layout.source = "sysfs";
+            }
+        }
+    }
+#endif
+    return layout;
+}
+
+// Logical CPUs ordered so that consecutive entries alternate between nodes.
+// Pinning pool worker i to entry i keeps every node busy even when fewer
+// workers than CPUs are active.
+inline std::vector<int> interleavedCpuOrder(const NumaLayout &layout) {
+    std::vector<std::vector<int>> nodeCpus(layout.nodeCount);
+    for (int cpu = 0; cpu < static_cast<int>(layout.cpuNode.size()); ++cpu) {
+        nodeCpus[layout.cpuNode[cpu]].push_back(cpu);
+    }
+    std::vector<int> order;
+    for (size_t k = 0; order.size() < layout.cpuNode.size(); ++k) {
+        for (const auto &cpus : nodeCpus) {
+            if (k < cpus.size()) {
+                order.push_back(cpus[k]);
+            }
+        }
+    }
+    return order;
+}
+
+// Rows for `workers` pool workers such that every row is reduced on the node
+// that first-touched it. The matrix is assumed to have been written by
+// `firstTouchWorkers` workers, worker b owning partitionRows(rows,
+// firstTouchWorkers, b). Each such block goes to the workers sharing its CPU
+// slot; blocks without one are split between workers on the same node.
+inline std::vector<std::vector<RowRange>> numaRowPlan(int rows, int firstTouchWorkers, int workers,
+                                                      const std::vector<int> &workerNodes) {
+    std::vector<std::vector<RowRange>> plan(workers);
+    std::vector<int> owners;
+    for (int block = 0; block < firstTouchWorkers; ++block) {
+        owners.clear();
+        for (int t = block; t < workers; t += firstTouchWorkers) {
+            owners.push_back(t);
+        }
+        if (owners.empty()) {
+            for (int t = 0; t < workers; ++t) {
+                if (workerNodes[t] == workerNodes[block]) {
+                    owners.push_back(t);
+                }
+            }
+        }
+        if (owners.empty()) {
+            owners.push_back(block % workers);
+        }
+        RowRange blockRows = partitionRows(rows, firstTouchWorkers, block);
+        int blockSize = blockRows.endRow - blockRows.startRow;
+        int ownerCount = static_cast<int>(owners.size());
+        for (int k = 0; k < ownerCount; ++k) {
+            RowRange part = partitionRows(blockSize, ownerCount, k);
+            if (part.endRow > part.startRow) {
+                plan[owners[k]].push_back({blockRows.startRow + part.startRow, blockRows.startRow + part.endRow});
+            }
+        }
+    }
+    return plan;
+}
+
+#endif //TASK_NUMA_H
@@ -0,0 +1,122 @@
+#ifndef TASK_PAGES_H
+#define TASK_PAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// How a matrix allocation is backed. Huge2M/Huge1G reserve explicit hugetlbfs
+// pages; Transparent asks the kernel to back an ordinary mapping with 2 MB
+// pages when it can.
+enum class PagePolicy {
+    Default,
+    Transparent,
+    Huge2M,
+    Huge1G,
+};
+
+inline const char *pagePolicyName(PagePolicy policy) {
+    switch (policy) {
+        case PagePolicy::Default:
+            return "4k";
+        case PagePolicy::Transparent:
+            return "thp";
+        case PagePolicy::Huge2M:
+            return "2m";
+        case PagePolicy::Huge1G:
+            return "1g";
+    }
+    return "unknown";
+}
+
+inline bool parsePagePolicy(const std::string &name, PagePolicy &policy) {
+    for (PagePolicy candidate : {PagePolicy::Default, PagePolicy::Transparent, PagePolicy::Huge2M, PagePolicy::Huge1G}) {
+        if (name == pagePolicyName(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr size_t HugePageSize2M = size_t(2) << 20;
+constexpr size_t HugePageSize1G = size_t(1) << 30;
+
+inline size_t roundUpTo(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+#if defined(__linux__)
+
+inline std::shared_ptr<void> mapHugePages(size_t bytes, size_t pageSize, int pageShift) {
+#ifdef MAP_HUGETLB
+    const int hugeShift = 26; // MAP_HUGE_SHIFT
+    size_t length = roundUpTo(bytes, pageSize);
+    void *address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (pageShift << hugeShift),
+                         -1, 0);
+    if (address != MAP_FAILED) {
+        return std::shared_ptr<void>(address, [length](void *base) { munmap(base, length); });
+    }
+#endif
+    return nullptr;
+}
+
+// Over-allocates by one huge page so the usable block starts 2 MB aligned;
+// khugepaged and the fault path only use huge pages for aligned ranges.
+inline std::shared_ptr<void> mapTransparentHugePages(size_t bytes) {
+#ifdef MADV_HUGEPAGE
+    size_t length = roundUpTo(bytes, HugePageSize2M) + HugePageSize2M;
+    void *address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t aligned = roundUpTo(reinterpret_cast<uintptr_t>(address), HugePageSize2M);
+    if (madvise(reinterpret_cast<void *>(aligned), length - HugePageSize2M, MADV_HUGEPAGE) != 0) {
+        munmap(address, length);
+        return nullptr;
+    }
+    std::shared_ptr<void> mapping(address, [length](void *base) { munmap(base, length); });
+    return std::shared_ptr<void>(mapping, reinterpret_cast<void *>(aligned));
+#else
+    (void) bytes;
+    return nullptr;
+#endif
+}
+
+#endif
+
+// Allocates `bytes` aligned to at least `alignment`, trying the requested
+// page policy first and falling back 1G -> 2M -> transparent -> 4k. Huge
+// pages are only used when the block fills at least one of them. `granted`
+// receives the policy that actually backs the block.
+inline std::shared_ptr<void> allocatePages(size_t bytes, size_t alignment, PagePolicy requested, PagePolicy &granted) {
+#if defined(__linux__)
+    std::shared_ptr<void> block;
+    if (requested == PagePolicy::Huge1G && bytes >= HugePageSize1G && (block = mapHugePages(bytes, HugePageSize1G, 30))) {
+        granted = PagePolicy::Huge1G;
+        return block;
+    }
+    if ((requested == PagePolicy::Huge1G || requested == PagePolicy::Huge2M) && bytes >= HugePageSize2M &&
+        (block = mapHugePages(bytes, HugePageSize2M, 21))) {
+        granted = PagePolicy::Huge2M;
+        return block;
+    }
+    if (requested != PagePolicy::Default && bytes >= HugePageSize2M && (block = mapTransparentHugePages(bytes))) {
+        granted = PagePolicy::Transparent;
+        return block;
+    }
+#else
+    (void) requested;
+#endif
+    granted = PagePolicy::Default;
+    return std::shared_ptr<void>(::operator new(bytes, std::align_val_t{alignment}),
+                                 [alignment](void *data) { ::operator delete(data, std::align_val_t{alignment}); });
+}
+
+#endif //TASK_PAGES_H
@@ -0,0 +1,138 @@
+#ifndef TASK_PERF_H
+#define TASK_PERF_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum PerfEvent {
+    PerfCycles,
+    PerfInstructions,
+    PerfLlcMisses,
+    PerfDtlbMisses,
+    PerfContextSwitches,
+    PerfEventCount,
+};
+
+struct PerfCounts {
+    double values[PerfEventCount] = {};
+    bool available[PerfEventCount] = {};
+
+    PerfCounts &operator+=(const PerfCounts &other) {
+        for (int e = 0; e < PerfEventCount; ++e) {
+            values[e] += other.values[e];
+            available[e] = available[e] || other.available[e];
+        }
+        return *this;
+    }
+
+    double ipc() const {
+        return available[PerfCycles] && available[PerfInstructions] && values[PerfCycles] > 0
+               ? values[PerfInstructions] / values[PerfCycles] : 0.0;
+    }
+};
+
+// One set of per-thread counters (cycles, instructions, LLC and dTLB read
+// misses, context switches) opened with perf_event_open for the calling
+// thread. Events the kernel or hardware refuses are reported as unavailable
+// rather than failing the whole set.
+class PerfCounterSet {
+public:
+    PerfCounterSet() {
+#if defined(__linux__)
+        const uint64_t llcMiss = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const uint64_t dtlbMiss = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        openEvent(PerfCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        openEvent(PerfInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        openEvent(PerfLlcMisses, PERF_TYPE_HW_CACHE, llcMiss);
+        openEvent(PerfDtlbMisses, PERF_TYPE_HW_CACHE, dtlbMiss);
+        openEvent(PerfContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+#endif
+    }
+
+    PerfCounterSet(const PerfCounterSet &) = delete;
+    PerfCounterSet &operator=(const PerfCounterSet &) = delete;
+
+    ~PerfCounterSet() {
+#if defined(__linux__)
+        for (int fd : m_fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    void start() {
+#if defined(__linux__)
+        for (int fd : m_fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Stops counting and returns the counts since start(), scaled up when the
+    // kernel had to multiplex an event. An event that could not be read or
+    // never got onto the PMU stays unavailable instead of reading as zero.
+    PerfCounts stop() {
+        PerfCounts counts;
+#if defined(__linux__)
+        for (int e = 0; e < PerfEventCount; ++e) {
+            if (m_fds[e] >= 0) {
+                ioctl(m_fds[e], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int e = 0; e < PerfEventCount; ++e) {
+            uint64_t data[3];
+            if (m_fds[e] >= 0 && read(m_fds[e], data, sizeof(data)) == sizeof(data) && data[2] > 0) {
+                counts.values[e] = double(data[0]) * double(data[1]) / double(data[2]);
+                counts.available[e] = true;
+            }
+        }
+#endif
+        return counts;
+    }
+
+    bool anyAvailable() const {
+        for (int fd : m_fds) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static PerfCounterSet &forCurrentThread() {
+        thread_local PerfCounterSet counters;
+        return counters;
+    }
+
+private:
+#if defined(__linux__)
+    void openEvent(int index, uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = type != PERF_TYPE_SOFTWARE;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        m_fds[index] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    int m_fds[PerfEventCount] = {-1, -1, -1, -1, -1};
+};
+
+#endif //TASK_PERF_H
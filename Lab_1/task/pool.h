@@ -0,0 +1,148 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+struct RowRange {
+    int startRow;
+    int endRow;
+};
+
+// Splits rows into `parts` contiguous ranges whose sizes differ by at most one.
+inline RowRange partitionRows(int rows, int parts, int index) {
+    int rowsPerPart = rows / parts;
+    int extraRows = rows % parts;
+    int startRow = index * rowsPerPart + std::min(index, extraRows);
+    int endRow = startRow + rowsPerPart + (index < extraRows ? 1 : 0);
+    return {startRow, endRow};
+}
+
+inline bool pinCurrentThread(int cpu) {
+#if defined(_WIN32)
+    if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void) cpu;
+    return false;
+#endif
+}
+
+inline std::vector<int> sequentialCpuOrder() {
+    std::vector<int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+    for (int cpu = 0; cpu < static_cast<int>(cpus.size()); ++cpu) {
+        cpus[cpu] = cpu;
+    }
+    return cpus;
+}
+
+// Fixed set of worker threads that are created once and reused for every run.
+// run() wakes the first `workers` threads, hands each its index and returns
+// once all of them have finished, so thread creation never lands inside a
+// timed region. Worker i is pinned to cpus[i % cpus.size()]; an empty list
+// leaves scheduling to the OS.
+class WorkerPool {
+public:
+    WorkerPool(int threadCount, std::vector<int> cpus) : m_cpus(std::move(cpus)) {
+        m_threads.reserve(threadCount);
+        for (int i = 0; i < threadCount; ++i) {
+            m_threads.emplace_back([this, i] {
+                if (!m_cpus.empty()) {
+                    pinCurrentThread(cpuOf(i));
+                }
+                workerLoop(i);
+            });
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+        for (auto &thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    int size() const { return static_cast<int>(m_threads.size()); }
+
+    int cpuOf(int worker) const { return m_cpus.empty() ? -1 : m_cpus[worker % m_cpus.size()]; }
+
+    void run(int workers, const std::function<void(int)> &task) {
+        workers = std::min(workers, size());
+        if (workers <= 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_activeWorkers = workers;
+        m_remaining = workers;
+        ++m_generation;
+        m_start.notify_all();
+        m_done.wait(lock, [this] { return m_remaining == 0; });
+        m_task = nullptr;
+    }
+
+private:
+    void workerLoop(int index) {
+        unsigned long long seenGeneration = 0;
+        while (true) {
+            const std::function<void(int)> *task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&] { return m_stop || (m_generation != seenGeneration && index < m_activeWorkers); });
+                if (m_stop) {
+                    return;
+                }
+                seenGeneration = m_generation;
+                task = m_task;
+            }
+            (*task)(index);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_remaining == 0) {
+                    m_done.notify_one();
+                }
+            }
+        }
+    }
+
+    std::vector<int> m_cpus;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(int)> *m_task = nullptr;
+    int m_activeWorkers = 0;
+    int m_remaining = 0;
+    unsigned long long m_generation = 0;
+    bool m_stop = false;
+};
+
+#endif //TASK_POOL_H
@@ -0,0 +1,219 @@
+#ifndef TASK_REDUCE_H
+#define TASK_REDUCE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "kernels.h"
+#include "matrix.h"
+#include "pool.h"
+
+#if defined(_MSC_VER)
+#define REDUCE_INLINE __forceinline
+#else
+#define REDUCE_INLINE inline __attribute__((always_inline))
+#endif
+
+// Reduction operations. Each one maps an element into the accumulator type,
+// combines two accumulators associatively, and finishes the reduced value.
+// Everything is static so a reduction instantiated for one op, element type
+// and accumulator compiles to a loop the compiler can unroll and vectorize.
+template <typename Acc>
+struct SumOp {
+    static constexpr const char *name = "sum";
+    static constexpr Acc identity() { return Acc(0); }
+    template <typename T>
+    static Acc map(T value) { return Acc(value); }
+    static Acc combine(Acc a, Acc b) { return a + b; }
+    static Acc finish(Acc a) { return a; }
+};
+
+template <typename Acc>
+struct MinOp {
+    static constexpr const char *name = "min";
+    static constexpr Acc identity() { return std::numeric_limits<Acc>::max(); }
+    template <typename T>
+    static Acc map(T value) { return Acc(value); }
+    static Acc combine(Acc a, Acc b) { return b < a ? b : a; }
+    static Acc finish(Acc a) { return a; }
+};
+
+template <typename Acc>
+struct MaxOp {
+    static constexpr const char *name = "max";
+    static constexpr Acc identity() { return std::numeric_limits<Acc>::lowest(); }
+    template <typename T>
+    static Acc map(T value) { return Acc(value); }
+    static Acc combine(Acc a, Acc b) { return b > a ? b : a; }
+    static Acc finish(Acc a) { return a; }
+};
+
+template <typename Acc>
+struct L1NormOp {
+    static constexpr const char *name = "l1";
+    static constexpr Acc identity() { return Acc(0); }
+    template <typename T>
+    static Acc map(T value) { return value < 0 ? -Acc(value) : Acc(value); }
+    static Acc combine(Acc a, Acc b) { return a + b; }
+    static Acc finish(Acc a) { return a; }
+};
+
+// Accumulates squares; finish() takes the root, so Acc should be floating.
+template <typename Acc>
+struct L2NormOp {
+    static constexpr const char *name = "l2";
+    static constexpr Acc identity() { return Acc(0); }
+    template <typename T>
+    static Acc map(T value) { return Acc(value) * Acc(value); }
+    static Acc combine(Acc a, Acc b) { return a + b; }
+    static Acc finish(Acc a) { return std::sqrt(a); }
+};
+
+// Number of non-zero elements.
+template <typename Acc>
+struct CountOp {
+    static constexpr const char *name = "count";
+    static constexpr Acc identity() { return Acc(0); }
+    template <typename T>
+    static Acc map(T value) { return value != 0 ? Acc(1) : Acc(0); }
+    static Acc combine(Acc a, Acc b) { return a + b; }
+    static Acc finish(Acc a) { return a; }
+};
+
+constexpr int ReduceLanes = 8;
+
+// Unfinished reduction of one contiguous run. Eight independent partials
+// break the dependency chain, which also lets floating-point sums vectorize
+// without -ffast-math.
+template <typename Op, typename T, typename Acc>
+REDUCE_INLINE Acc reduceSpanBody(const T *data, size_t size) {
+    Acc partial[ReduceLanes];
+    for (int lane = 0; lane < ReduceLanes; ++lane) {
+        partial[lane] = Op::identity();
+    }
+    size_t j = 0;
+    for (; j + ReduceLanes <= size; j += ReduceLanes) {
+        for (int lane = 0; lane < ReduceLanes; ++lane) {
+            partial[lane] = Op::combine(partial[lane], Op::template map<T>(data[j + lane]));
+        }
+    }
+    Acc result = Op::identity();
+    for (; j < size; ++j) {
+        result = Op::combine(result, Op::template map<T>(data[j]));
+    }
+    for (int lane = 0; lane < ReduceLanes; ++lane) {
+        result = Op::combine(result, partial[lane]);
+    }
+    return result;
+}
+
+// Folds one row segment into the matching column accumulators.
+template <typename Op, typename T, typename Acc>
+REDUCE_INLINE void accumulateTileBody(Acc *accumulators, const T *row, size_t size) {
+    for (size_t j = 0; j < size; ++j) {
+        accumulators[j] = Op::combine(accumulators[j], Op::template map<T>(row[j]));
+    }
+}
+
+// The bodies are compiled once for the baseline ISA and once for AVX2, and
+// the AVX2 copies are picked at run time like the row-sum kernels.
+template <typename Op, typename T, typename Acc>
+struct ReduceKernels {
+    Acc (*span)(const T *data, size_t size);
+    void (*tile)(Acc *accumulators, const T *row, size_t size);
+};
+
+template <typename Op, typename T, typename Acc>
+Acc reduceSpanBaseline(const T *data, size_t size) {
+    return reduceSpanBody<Op, T, Acc>(data, size);
+}
+
+template <typename Op, typename T, typename Acc>
+void accumulateTileBaseline(Acc *accumulators, const T *row, size_t size) {
+    accumulateTileBody<Op, T, Acc>(accumulators, row, size);
+}
+
+#ifdef KERNELS_X86
+
+template <typename Op, typename T, typename Acc>
+KERNEL_TARGET("avx2")
+Acc reduceSpanAvx2(const T *data, size_t size) {
+    return reduceSpanBody<Op, T, Acc>(data, size);
+}
+
+template <typename Op, typename T, typename Acc>
+KERNEL_TARGET("avx2")
+void accumulateTileAvx2(Acc *accumulators, const T *row, size_t size) {
+    accumulateTileBody<Op, T, Acc>(accumulators, row, size);
+}
+
+#endif
+
+template <typename Op, typename T, typename Acc>
+ReduceKernels<Op, T, Acc> reduceKernels() {
+#ifdef KERNELS_X86
+    if (isKernelSupported(RowSumKernel::Avx2)) {
+        return {reduceSpanAvx2<Op, T, Acc>, accumulateTileAvx2<Op, T, Acc>};
+    }
+#endif
+    return {reduceSpanBaseline<Op, T, Acc>, accumulateTileBaseline<Op, T, Acc>};
+}
+
+// out[i] = Op over row i, rows split into contiguous blocks across the pool.
+template <typename Op, typename T, typename Acc>
+void reduceRows(const Matrix<T> &matrix, Acc *out, WorkerPool &pool, int workers) {
+    int rows = static_cast<int>(matrix.rows());
+    workers = std::max(1, std::min({workers, rows, pool.size()}));
+    auto span = reduceKernels<Op, T, Acc>().span;
+    pool.run(workers, [&](int worker) {
+        RowRange range = partitionRows(rows, workers, worker);
+        for (int i = range.startRow; i < range.endRow; ++i) {
+            out[i] = Op::finish(span(matrix[i].data(), matrix.cols()));
+        }
+    });
+}
+
+// out[j] = Op over column j. Walking a column of a row-major matrix touches
+// one cache line per element, so instead every worker takes a block of rows
+// and sweeps it one column tile at a time: the tile's partial results stay
+// in L1 while the rows stream past, and each row segment is read
+// contiguously. The per-worker partials are then merged column-parallel.
+template <typename Op, typename T, typename Acc>
+void reduceColumns(const Matrix<T> &matrix, Acc *out, WorkerPool &pool, int workers, size_t tileBytes = 16 * 1024) {
+    int rows = static_cast<int>(matrix.rows());
+    size_t cols = matrix.cols();
+    workers = std::max(1, std::min({workers, rows, pool.size()}));
+    size_t tile = std::max<size_t>(ReduceLanes, tileBytes / sizeof(Acc) / ReduceLanes * ReduceLanes);
+    std::vector<std::vector<Acc>> partials(workers);
+    auto accumulateTile = reduceKernels<Op, T, Acc>().tile;
+
+    pool.run(workers, [&](int worker) {
+        std::vector<Acc> &partial = partials[worker];
+        partial.assign(cols, Op::identity());
+        RowRange range = partitionRows(rows, workers, worker);
+        for (size_t first = 0; first < cols; first += tile) {
+            size_t last = std::min(first + tile, cols);
+            Acc *accumulators = partial.data() + first;
+            for (int i = range.startRow; i < range.endRow; ++i) {
+                accumulateTile(accumulators, matrix[i].data() + first, last - first);
+            }
+        }
+    });
+
+    int mergeWorkers = static_cast<int>(std::min<size_t>(workers, cols));
+    pool.run(mergeWorkers, [&](int worker) {
+        RowRange range = partitionRows(static_cast<int>(cols), mergeWorkers, worker);
+        for (int j = range.startRow; j < range.endRow; ++j) {
+            Acc result = partials[0][j];
+            for (int w = 1; w < workers; ++w) {
+                result = Op::combine(result, partials[w][j]);
+            }
+            out[j] = Op::finish(result);
+        }
+    });
+}
+
+#endif //TASK_REDUCE_H
@@ -0,0 +1,102 @@
+#ifndef TASK_SCHEDULE_H
+#define TASK_SCHEDULE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "pool.h"
+
+enum class Schedule {
+    Static,
+    Dynamic,
+    Guided,
+};
+
+inline const char *scheduleName(Schedule schedule) {
+    switch (schedule) {
+        case Schedule::Static:
+            return "static";
+        case Schedule::Dynamic:
+            return "dynamic";
+        case Schedule::Guided:
+            return "guided";
+    }
+    return "unknown";
+}
+
+inline bool parseSchedule(const std::string &name, Schedule &schedule) {
+    for (Schedule candidate : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}) {
+        if (name == scheduleName(candidate)) {
+            schedule = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Shared cursor that workers pull row blocks from until the matrix is done.
+// Dynamic blocks are always `grain` rows; guided blocks are the remaining
+// rows split across the workers, shrinking towards `grain` like OpenMP's
+// schedule(guided).
+class RowCursor {
+public:
+    RowCursor(int rows, int workers, int grain, Schedule schedule)
+        : m_rows(rows), m_workers(std::max(1, workers)), m_grain(std::max(1, grain)), m_schedule(schedule) {}
+
+    bool next(RowRange &range) {
+        if (m_schedule != Schedule::Guided) {
+            int start = m_next.fetch_add(m_grain, std::memory_order_relaxed);
+            if (start >= m_rows) {
+                return false;
+            }
+            range = {start, std::min(start + m_grain, m_rows)};
+            return true;
+        }
+        int start = m_next.load(std::memory_order_relaxed);
+        int size;
+        do {
+            if (start >= m_rows) {
+                return false;
+            }
+            size = std::max(m_grain, (m_rows - start + m_workers - 1) / m_workers);
+        } while (!m_next.compare_exchange_weak(start, start + size, std::memory_order_relaxed));
+        range = {start, std::min(start + size, m_rows)};
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<int> m_next{0};
+    int m_rows;
+    int m_workers;
+    int m_grain;
+    Schedule m_schedule;
+};
+
+// Default block size for the shared cursor: at most what fits the per-core
+// cache, and small enough that every worker gets about eight blocks so a
+// straggler can be absorbed by the others.
+inline int dynamicGrain(int rows, int workers, size_t cacheRows) {
+    int perWorker = (rows + workers * 8 - 1) / (workers * 8);
+    return std::max(1, std::min(perWorker, static_cast<int>(std::min<size_t>(cacheRows, rows))));
+}
+
+// How much longer the busiest worker ran than the average one, in percent;
+// 0 means a perfectly balanced run.
+inline double loadImbalance(const std::vector<double> &workerSeconds) {
+    if (workerSeconds.empty()) {
+        return 0.0;
+    }
+    double total = 0.0;
+    double longest = 0.0;
+    for (double seconds : workerSeconds) {
+        total += seconds;
+        longest = std::max(longest, seconds);
+    }
+    double mean = total / workerSeconds.size();
+    return mean > 0 ? (longest / mean - 1.0) * 100.0 : 0.0;
+}
+
+#endif //TASK_SCHEDULE_H
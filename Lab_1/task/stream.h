@@ -0,0 +1,141 @@
+#ifndef TASK_STREAM_H
+#define TASK_STREAM_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pool.h"
+#include "reduce.h"
+#include "topology.h"
+
+enum StreamKernel {
+    StreamCopy,
+    StreamScale,
+    StreamAdd,
+    StreamTriad,
+    StreamReduce,
+    StreamKernelCount,
+};
+
+inline const char *streamKernelName(int kernel) {
+    static const char *names[StreamKernelCount] = {"copy", "scale", "add", "triad", "reduce"};
+    return kernel >= 0 && kernel < StreamKernelCount ? names[kernel] : "unknown";
+}
+
+// Best bandwidth of each STREAM kernel in GB/s, counting bytes the way
+// STREAM does (reads plus writes, no write-allocate traffic).
+struct StreamBandwidth {
+    double gbPerSecond[StreamKernelCount] = {};
+    size_t arrayBytes = 0;
+    int threads = 0;
+
+    bool measured() const { return threads > 0; }
+
+    // The row sums only read the matrix, so the read-only reduce is their
+    // ceiling.
+    double readPeak() const { return gbPerSecond[StreamReduce]; }
+};
+
+constexpr int StreamTrials = 5;
+
+// Each array should be at least four times the last-level cache so no trial
+// runs from cache, capped so the probe stays quick and fits in memory.
+inline size_t streamArrayBytes(const Topology &topology) {
+    size_t bytes = std::max<size_t>(size_t(32) << 20, topology.lastLevelCacheSize() * 4);
+    bytes = std::min<size_t>(bytes, size_t(256) << 20);
+    if (topology.availableMemory > 0) {
+        bytes = std::min<size_t>(bytes, topology.availableMemory / 8);
+    }
+    return bytes;
+}
+
+// STREAM copy/scale/add/triad plus a read-only sum over three double arrays,
+// split across `workers` pool threads the same way the row sums are. The
+// arrays are first touched by the workers that use them, and every kernel
+// keeps the best of StreamTrials runs.
+inline StreamBandwidth probeStreamBandwidth(WorkerPool &pool, int workers, size_t arrayBytes) {
+    StreamBandwidth result;
+    int count = static_cast<int>(arrayBytes / sizeof(double));
+    workers = std::max(1, std::min(workers, pool.size()));
+    std::unique_ptr<double[]> a(new double[count]);
+    std::unique_ptr<double[]> b(new double[count]);
+    std::unique_ptr<double[]> c(new double[count]);
+    std::vector<double> partials(workers);
+    auto span = reduceKernels<SumOp<double>, double, double>().span;
+    const double scalar = 3.0;
+
+    pool.run(workers, [&](int worker) {
+        RowRange range = partitionRows(count, workers, worker);
+        for (int i = range.startRow; i < range.endRow; ++i) {
+            a[i] = 1.0;
+            b[i] = 2.0;
+            c[i] = 0.0;
+        }
+    });
+
+    const double arrays[StreamKernelCount] = {2, 2, 3, 3, 1};
+    for (int trial = 0; trial < StreamTrials; ++trial) {
+        for (int kernel = 0; kernel < StreamKernelCount; ++kernel) {
+            auto start = std::chrono::high_resolution_clock::now();
+            pool.run(workers, [&](int worker) {
+                RowRange range = partitionRows(count, workers, worker);
+                double *x = a.get(), *y = b.get(), *z = c.get();
+                switch (kernel) {
+                    case StreamCopy:
+                        for (int i = range.startRow; i < range.endRow; ++i) {
+                            z[i] = x[i];
+                        }
+                        break;
+                    case StreamScale:
+                        for (int i = range.startRow; i < range.endRow; ++i) {
+                            y[i] = scalar * z[i];
+                        }
+                        break;
+                    case StreamAdd:
+                        for (int i = range.startRow; i < range.endRow; ++i) {
+                            z[i] = x[i] + y[i];
+                        }
+                        break;
+                    case StreamTriad:
+                        for (int i = range.startRow; i < range.endRow; ++i) {
+                            x[i] = y[i] + scalar * z[i];
+                        }
+                        break;
+                    default:
+                        partials[worker] = span(x + range.startRow, range.endRow - range.startRow);
+                        break;
+                }
+            });
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            double gbPerSecond = seconds > 0 ? arrays[kernel] * count * sizeof(double) / seconds * 1e-9 : 0.0;
+            result.gbPerSecond[kernel] = std::max(result.gbPerSecond[kernel], gbPerSecond);
+        }
+    }
+    result.arrayBytes = size_t(count) * sizeof(double);
+    result.threads = workers;
+    return result;
+}
+
+// Roofline verdict for a run that read `bytes` at `gbPerSecond`. Row sums do
+// one add per element, far below any machine's ridge point, so the memory
+// roof is the one that matters: a matrix that fits in the last-level cache
+// can beat it, anything larger is judged by how close it gets.
+inline std::string rooflineVerdict(double gbPerSecond, double peakGbPerSecond, double bytes, size_t lastLevelCache) {
+    if (peakGbPerSecond <= 0) {
+        return "-";
+    }
+    if (bytes <= lastLevelCache) {
+        return "in cache";
+    }
+    double percent = gbPerSecond / peakGbPerSecond * 100.0;
+    if (percent >= 80.0) {
+        return "at roof";
+    }
+    return percent >= 50.0 ? "near roof" : "below roof";
+}
+
+#endif //TASK_STREAM_H
@@ -0,0 +1,407 @@
+#ifndef TASK_TOPOLOGY_H
+#define TASK_TOPOLOGY_H
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "kernels.h"
+#include "numa.h"
+
+struct CacheInfo {
+    int level = 0;
+    std::string type;
+    size_t sizeBytes = 0;
+    int lineSize = 0;
+    int sharedCpus = 1;
+};
+
+struct Topology {
+    std::string architecture = "Unknown";
+    std::string cpuModel = "Unknown";
+    int logicalCpus = 1;
+    int physicalCores = 1;
+    int packages = 1;
+    size_t pageSize = 4096;
+    unsigned long long totalMemory = 0;
+    unsigned long long availableMemory = 0;
+    NumaLayout numa;
+    std::vector<CacheInfo> caches;
+    std::string cacheSource = "none";
+
+    int smtPerCore() const { return std::max(1, logicalCpus / std::max(1, physicalCores)); }
+
+    // Data (or unified) cache size at `level`, or 0 if that level was not found.
+    size_t dataCacheSize(int level) const {
+        for (const CacheInfo &cache : caches) {
+            if (cache.level == level && cache.type != "Instruction") {
+                return cache.sizeBytes;
+            }
+        }
+        return 0;
+    }
+
+    // Size of the outermost data or unified cache, or 0 if none was found.
+    size_t lastLevelCacheSize() const {
+        size_t size = 0;
+        int outermost = 0;
+        for (const CacheInfo &cache : caches) {
+            if (cache.type != "Instruction" && cache.level >= outermost) {
+                size = cache.level > outermost ? cache.sizeBytes : std::max(size, cache.sizeBytes);
+                outermost = cache.level;
+            }
+        }
+        return size;
+    }
+
+    int lineSize() const {
+        for (const CacheInfo &cache : caches) {
+            if (cache.lineSize > 0) {
+                return cache.lineSize;
+            }
+        }
+        return 64;
+    }
+
+    // Cache available to one core at `level` when every sibling sharing it is busy.
+    size_t perCoreCacheSize(int level) const {
+        for (const CacheInfo &cache : caches) {
+            if (cache.level == level && cache.type != "Instruction") {
+                int sharingCores = std::max(1, cache.sharedCpus / smtPerCore());
+                return cache.sizeBytes / sharingCores;
+            }
+        }
+        return 0;
+    }
+
+    // Number of rows of `rowBytes` each that fit in half of a core's share of
+    // the given cache level, leaving room for the other operands.
+    size_t cacheBlockRows(size_t rowBytes, int level = 2) const {
+        size_t cacheBytes = perCoreCacheSize(level);
+        if (cacheBytes == 0) {
+            cacheBytes = size_t(256) * 1024;
+        }
+        return std::max<size_t>(1, cacheBytes / 2 / std::max<size_t>(1, rowBytes));
+    }
+
+    // Thread counts for the sweep: physical cores, all logical CPUs, then
+    // increasing oversubscription.
+    std::vector<int> sweepThreadCounts() const {
+        std::vector<int> counts = {physicalCores, logicalCpus};
+        for (int factor : {2, 4, 8, 16}) {
+            counts.push_back(logicalCpus * factor);
+        }
+        counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+        return counts;
+    }
+};
+
+#ifdef KERNELS_X86
+
+inline std::string cpuBrandString() {
+    int regs[4];
+    cpuid(0x80000000, 0, regs);
+    if (static_cast<unsigned>(regs[0]) < 0x80000004u) {
+        return "";
+    }
+    char brand[49] = {};
+    for (int leaf = 0; leaf < 3; ++leaf) {
+        cpuid(0x80000002 + leaf, 0, regs);
+        std::memcpy(brand + leaf * 16, regs, sizeof(regs));
+    }
+    std::string result = brand;
+    result.erase(0, result.find_first_not_of(' '));
+    return result;
+}
+
+// Deterministic cache parameters: leaf 4 on Intel, leaf 0x8000001D on AMD.
+// Size is ways * partitions * line size * sets, each field stored minus one.
+inline std::vector<CacheInfo> cpuidCaches() {
+    int regs[4];
+    cpuid(0, 0, regs);
+    int maxLeaf = regs[0];
+    char vendor[13] = {};
+    std::memcpy(vendor, &regs[1], 4);
+    std::memcpy(vendor + 4, &regs[3], 4);
+    std::memcpy(vendor + 8, &regs[2], 4);
+
+    int leaf = 4;
+    if (std::strcmp(vendor, "AuthenticAMD") == 0 || std::strcmp(vendor, "HygonGenuine") == 0) {
+        cpuid(0x80000000, 0, regs);
+        if (static_cast<unsigned>(regs[0]) < 0x8000001Du) {
+            return {};
+        }
+        leaf = 0x8000001D;
+    } else if (maxLeaf < 4) {
+        return {};
+    }
+
+    std::vector<CacheInfo> caches;
+    for (int subleaf = 0; subleaf < 16; ++subleaf) {
+        cpuid(leaf, subleaf, regs);
+        int cacheType = regs[0] & 0x1F;
+        if (cacheType == 0) {
+            break;
+        }
+        CacheInfo cache;
+        cache.level = (regs[0] >> 5) & 0x7;
+        cache.type = cacheType == 1 ? "Data" : (cacheType == 2 ? "Instruction" : "Unified");
+        size_t ways = ((static_cast<unsigned>(regs[1]) >> 22) & 0x3FF) + 1;
+        size_t partitions = ((static_cast<unsigned>(regs[1]) >> 12) & 0x3FF) + 1;
+        size_t lineSize = (static_cast<unsigned>(regs[1]) & 0xFFF) + 1;
+        size_t sets = static_cast<unsigned>(regs[2]) + size_t(1);
+        cache.sizeBytes = ways * partitions * lineSize * sets;
+        cache.lineSize = static_cast<int>(lineSize);
+        cache.sharedCpus = ((static_cast<unsigned>(regs[0]) >> 14) & 0xFFF) + 1;
+        caches.push_back(cache);
+    }
+    return caches;
+}
+
+#endif
+
+#if defined(__linux__)
+
+inline std::string readSysfsString(const std::string &path) {
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+inline long long readSysfsNumber(const std::string &path, long long fallback) {
+    std::string value = readSysfsString(path);
+    try {
+        return value.empty() ? fallback : std::stoll(value);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+// Accepts the "48K" / "2048K" / "105M" notation used under cache/index*/size.
+inline size_t parseCacheSize(const std::string &value) {
+    if (value.empty()) {
+        return 0;
+    }
+    size_t size = std::stoull(value);
+    char unit = value.back();
+    if (unit == 'K') {
+        size *= 1024;
+    } else if (unit == 'M') {
+        size *= 1024 * 1024;
+    }
+    return size;
+}
+
+inline int countCpuList(const std::string &list) {
+    int count = 0;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t dash = item.find('-');
+        count += dash == std::string::npos ? 1 : std::stoi(item.substr(dash + 1)) - std::stoi(item.substr(0, dash)) + 1;
+    }
+    return std::max(1, count);
+}
+
+inline void probeLinuxTopology(Topology &topology) {
+    std::set<std::pair<long long, long long>> cores;
+    std::set<long long> packages;
+    for (int cpu = 0; cpu < topology.logicalCpus; ++cpu) {
+        std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        long long package = readSysfsNumber(base + "physical_package_id", 0);
+        packages.insert(package);
+        cores.insert({package, readSysfsNumber(base + "core_id", cpu)});
+    }
+    topology.physicalCores = std::max(1, static_cast<int>(cores.size()));
+    topology.packages = std::max(1, static_cast<int>(packages.size()));
+
+    for (int index = 0;; ++index) {
+        std::string base = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        std::string type = readSysfsString(base + "type");
+        if (type.empty()) {
+            break;
+        }
+        CacheInfo cache;
+        cache.level = static_cast<int>(readSysfsNumber(base + "level", 0));
+        cache.type = type;
+        cache.sizeBytes = parseCacheSize(readSysfsString(base + "size"));
+        cache.lineSize = static_cast<int>(readSysfsNumber(base + "coherency_line_size", 64));
+        cache.sharedCpus = countCpuList(readSysfsString(base + "shared_cpu_list"));
+        topology.caches.push_back(cache);
+        topology.cacheSource = "sysfs";
+    }
+
+    // One "Key: value [kB]" entry per line; some (HugePages_*) have no unit,
+    // so each line is parsed on its own.
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while (std::getline(meminfo, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        unsigned long long value;
+        if (!(fields >> key >> value)) {
+            continue;
+        }
+        if (key == "MemTotal:") {
+            topology.totalMemory = value * 1024;
+        } else if (key == "MemAvailable:") {
+            topology.availableMemory = value * 1024;
+        }
+    }
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize > 0) {
+        topology.pageSize = static_cast<size_t>(pageSize);
+    }
+
+    if (topology.cpuModel == "Unknown") {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.rfind("model name", 0) == 0) {
+                topology.cpuModel = line.substr(line.find(':') + 2);
+                break;
+            }
+        }
+    }
+}
+
+#endif
+
+#if defined(_WIN32)
+
+inline void probeWindowsTopology(Topology &topology) {
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    topology.pageSize = sysinfo.dwPageSize;
+
+    MEMORYSTATUSEX memInfo;
+    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+    if (GlobalMemoryStatusEx(&memInfo)) {
+        topology.totalMemory = memInfo.ullTotalPhys;
+        topology.availableMemory = memInfo.ullAvailPhys;
+    }
+
+    DWORD length = 0;
+    GetLogicalProcessorInformation(nullptr, &length);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (info.empty() || !GetLogicalProcessorInformation(info.data(), &length)) {
+        return;
+    }
+    int cores = 0;
+    int packages = 0;
+    int nodes = 0;
+    for (const auto &entry : info) {
+        int maskCpus = 0;
+        for (ULONG_PTR mask = entry.ProcessorMask; mask; mask >>= 1) {
+            maskCpus += mask & 1;
+        }
+        if (entry.Relationship == RelationProcessorCore) {
+            ++cores;
+        } else if (entry.Relationship == RelationProcessorPackage) {
+            ++packages;
+        } else if (entry.Relationship == RelationNumaNode) {
+            ++nodes;
+            for (int cpu = 0; cpu < static_cast<int>(topology.numa.cpuNode.size()); ++cpu) {
+                if ((entry.ProcessorMask >> cpu) & 1) {
+                    topology.numa.cpuNode[cpu] = static_cast<int>(entry.NumaNode.NodeNumber);
+                }
+            }
+        } else if (entry.Relationship == RelationCache && entry.Cache.Level >= 1) {
+            CacheInfo cache;
+            cache.level = entry.Cache.Level;
+            cache.type = entry.Cache.Type == CacheData ? "Data" : (entry.Cache.Type == CacheInstruction ? "Instruction" : "Unified");
+            cache.sizeBytes = entry.Cache.Size;
+            cache.lineSize = entry.Cache.LineSize;
+            cache.sharedCpus = std::max(1, maskCpus);
+            bool seen = false;
+            for (const CacheInfo &known : topology.caches) {
+                seen = seen || (known.level == cache.level && known.type == cache.type);
+            }
+            if (!seen) {
+                topology.caches.push_back(cache);
+                topology.cacheSource = "GetLogicalProcessorInformation";
+            }
+        }
+    }
+    topology.physicalCores = std::max(1, cores);
+    topology.packages = std::max(1, packages);
+    if (nodes > 0) {
+        topology.numa.nodeCount = nodes;
+        topology.numa.source = "GetLogicalProcessorInformation";
+    }
+}
+
+#endif
+
+inline Topology probeTopology() {
+    Topology topology;
+    topology.logicalCpus = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    topology.physicalCores = topology.logicalCpus;
+    topology.numa = probeNumaLayout();
+#if defined(__x86_64__) || defined(_M_X64)
+    topology.architecture = "x64";
+#elif defined(__i386__) || defined(_M_IX86)
+    topology.architecture = "x86";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    topology.architecture = "arm64";
+#endif
+#ifdef KERNELS_X86
+    std::string brand = cpuBrandString();
+    if (!brand.empty()) {
+        topology.cpuModel = brand;
+    }
+#endif
+#if defined(__linux__)
+    probeLinuxTopology(topology);
+#elif defined(_WIN32)
+    probeWindowsTopology(topology);
+#endif
+#ifdef KERNELS_X86
+    if (topology.caches.empty()) {
+        topology.caches = cpuidCaches();
+        topology.cacheSource = "cpuid";
+    }
+#endif
+    std::sort(topology.caches.begin(), topology.caches.end(), [](const CacheInfo &a, const CacheInfo &b) {
+        return a.level != b.level ? a.level < b.level : a.type < b.type;
+    });
+    return topology;
+}
+
+inline void printTopology(const Topology &topology) {
+    std::cout << "System Information:" << std::endl;
+    std::cout << "Processor: " << topology.cpuModel << std::endl;
+    std::cout << "Processor architecture: " << topology.architecture << std::endl;
+    std::cout << "Number of logical processors: " << topology.logicalCpus << std::endl;
+    std::cout << "Physical cores: " << topology.physicalCores << " in " << topology.packages << " package(s), "
+              << topology.smtPerCore() << " thread(s) per core" << std::endl;
+    std::cout << "NUMA nodes: " << topology.numa.nodeCount << " (" << topology.numa.source << ")" << std::endl;
+    std::cout << "Page size: " << topology.pageSize << " bytes" << std::endl;
+    std::cout << "Total physical memory: " << topology.totalMemory / (1024 * 1024) << " MB" << std::endl;
+    std::cout << "Available physical memory: " << topology.availableMemory / (1024 * 1024) << " MB" << std::endl;
+    for (const CacheInfo &cache : topology.caches) {
+        std::cout << "Cache Level: " << cache.level << ", Type: " << cache.type
+                  << ", Size: " << cache.sizeBytes / 1024 << " KB, Line: " << cache.lineSize
+                  << " B, Shared by: " << cache.sharedCpus << " CPU(s)" << std::endl;
+    }
+}
+
+#endif //TASK_TOPOLOGY_H
@@ -0,0 +1,119 @@
+#ifndef TASK_TUNER_H
+#define TASK_TUNER_H
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kernels.h"
+#include "topology.h"
+
+struct TunedConfig {
+    int threads = 1;
+    int grain = 0;
+    RowSumKernel kernel = RowSumKernel::Scalar;
+    double seconds = 0.0;
+    int prefetch = 0;
+    StoreMode stores = StoreMode::Normal;
+};
+
+// Identifies the machine a profile entry was measured on. Anything that
+// changes the best configuration (CPU model, core/node counts, cache sizes)
+// is part of the key, so a profile copied to a different host is ignored.
+inline std::string hostKey(const Topology &topology) {
+    std::string model = topology.cpuModel;
+    std::replace(model.begin(), model.end(), ' ', '_');
+    std::replace(model.begin(), model.end(), '\t', '_');
+    std::ostringstream key;
+    key << model << "/" << topology.logicalCpus << "t" << topology.physicalCores << "c" << topology.numa.nodeCount << "n"
+        << "/L2=" << topology.dataCacheSize(2) / 1024 << "K/L3=" << topology.dataCacheSize(3) / 1024 << "K";
+    return key.str();
+}
+
+// Candidate chunk sizes in rows; 0 means one contiguous block per worker.
+inline std::vector<int> tuningGrains(const Topology &topology, int matrixSize, size_t rowBytes) {
+    std::vector<int> grains = {0, static_cast<int>(topology.cacheBlockRows(rowBytes)), 64, 16, 4};
+    grains.erase(std::remove_if(grains.begin() + 1, grains.end(), [&](int grain) { return grain >= matrixSize; }), grains.end());
+    std::sort(grains.begin() + 1, grains.end(), std::greater<int>());
+    grains.erase(std::unique(grains.begin(), grains.end()), grains.end());
+    return grains;
+}
+
+// Plain-text profile, one entry per line:
+// host <TAB> accumulator <TAB> matrix size <TAB> threads <TAB> grain <TAB> kernel <TAB> seconds <TAB> prefetch <TAB> stores
+// The last two fields may be missing in older profiles.
+class TuningProfile {
+public:
+    bool load(const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::istringstream fields(line);
+            Entry entry;
+            std::string kernel;
+            if (fields >> entry.host >> entry.accumulator >> entry.matrixSize >> entry.config.threads >> entry.config.grain
+                       >> kernel >> entry.config.seconds && parseKernel(kernel, entry.config.kernel)) {
+                std::string stores;
+                if (fields >> entry.config.prefetch >> stores) {
+                    parseStoreMode(stores, entry.config.stores);
+                }
+                set(entry.host, entry.accumulator, entry.matrixSize, entry.config);
+            }
+        }
+        return true;
+    }
+
+    bool save(const std::string &path) const {
+        std::ofstream file(path);
+        if (!file) {
+            return false;
+        }
+        file << "# Lab_1 tuning profile: host, accumulator, matrix size, threads, grain, kernel, seconds, prefetch, stores" << std::endl;
+        for (const Entry &entry : m_entries) {
+            file << entry.host << '\t' << entry.accumulator << '\t' << entry.matrixSize << '\t' << entry.config.threads << '\t'
+                 << entry.config.grain << '\t' << kernelName(entry.config.kernel) << '\t' << entry.config.seconds
+                 << '\t' << entry.config.prefetch << '\t' << storeModeName(entry.config.stores) << std::endl;
+        }
+        return static_cast<bool>(file);
+    }
+
+    const TunedConfig *find(const std::string &host, const std::string &accumulator, int matrixSize) const {
+        for (const Entry &entry : m_entries) {
+            if (entry.host == host && entry.accumulator == accumulator && entry.matrixSize == matrixSize) {
+                return &entry.config;
+            }
+        }
+        return nullptr;
+    }
+
+    void set(const std::string &host, const std::string &accumulator, int matrixSize, const TunedConfig &config) {
+        for (Entry &entry : m_entries) {
+            if (entry.host == host && entry.accumulator == accumulator && entry.matrixSize == matrixSize) {
+                entry.config = config;
+                return;
+            }
+        }
+        m_entries.push_back({host, accumulator, matrixSize, config});
+    }
+
+private:
+    struct Entry {
+        std::string host;
+        std::string accumulator;
+        int matrixSize = 0;
+        TunedConfig config;
+    };
+
+    std::vector<Entry> m_entries;
+};
+
+#endif //TASK_TUNER_H
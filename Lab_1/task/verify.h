@@ -0,0 +1,57 @@
+#ifndef TASK_VERIFY_H
+#define TASK_VERIFY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "matrix.h"
+#include "pool.h"
+
+constexpr int VerifyRowsPerWorker = 4096;
+constexpr size_t VerifyReportedErrors = 5;
+
+// Checks every diagonal entry against the exact row sums recorded when the
+// matrix was generated, spread over the pool. An entry counts as wrong when
+// it differs from the expected sum or when the accumulator cannot hold it
+// exactly. Returns the number of wrong rows and prints the first few.
+template <typename Acc>
+size_t verifyRowSums(DiagonalView<Acc> diagonal, const std::vector<long long> &expected, WorkerPool &pool, int workers) {
+    int rows = static_cast<int>(std::min(diagonal.size(), expected.size()));
+    workers = std::max(1, std::min(workers, rows / VerifyRowsPerWorker));
+    std::vector<size_t> mismatches(workers, 0);
+    std::vector<std::vector<int>> badRows(workers);
+    pool.run(workers, [&](int worker) {
+        RowRange range = partitionRows(rows, workers, worker);
+        size_t wrong = 0;
+        for (int i = range.startRow; i < range.endRow; ++i) {
+            Acc actual = diagonal[i];
+            if (actual != static_cast<Acc>(expected[i]) || static_cast<long long>(actual) != expected[i]) {
+                if (badRows[worker].size() < VerifyReportedErrors) {
+                    badRows[worker].push_back(i);
+                }
+                ++wrong;
+            }
+        }
+        mismatches[worker] = wrong;
+    });
+
+    size_t total = 0;
+    size_t reported = 0;
+    for (int worker = 0; worker < workers; ++worker) {
+        total += mismatches[worker];
+        for (int row : badRows[worker]) {
+            if (reported < VerifyReportedErrors) {
+                ++reported;
+                std::cout << "Error in row " << row << ": Expected " << expected[row] << ", but got " << diagonal[row] << std::endl;
+            }
+        }
+    }
+    if (total > reported) {
+        std::cout << "... " << total << " wrong rows in total" << std::endl;
+    }
+    return total;
+}
+
+#endif //TASK_VERIFY_H